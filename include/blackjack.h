@@ -1,22 +1,33 @@
-#ifndef BLACKJACK_H
-#define BLACKJACK_H
-
-#include "deck.h"
-#include <stddef.h>
-
-#define MAX_HAND_CARDS 12
-
-typedef struct 
-{
-    Card cards[MAX_HAND_CARDS];
-    int count;
-} Hand;
-
-void hand_init(Hand *hand);
-void hand_add_card(Hand *hand, Card card);
-int hand_value(const Hand *hand);
-int hand_is_blackjack(const Hand *hand);
-int hand_is_bust(const Hand *hand);
-void hand_to_string(const Hand *hand, char *buf, size_t bufsize);
-
-#endif /* BLACKJACK_H */
+#ifndef BLACKJACK_H
+#define BLACKJACK_H
+
+#include "deck.h"
+#include "shoe.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_HAND_CARDS 12
+
+/* Totals are kept as cards are added, so every query below is O(1) */
+typedef struct 
+{
+    Card cards[MAX_HAND_CARDS];
+    uint8_t count;
+    uint8_t hard;             /* total with every ace counted as 1 */
+    uint8_t aces;
+} Hand;
+
+void hand_init(Hand *hand);
+void hand_add_card(Hand *hand, Card card);
+int hand_value(const Hand *hand);
+int hand_is_blackjack(const Hand *hand);
+int hand_is_bust(const Hand *hand);
+int hand_is_soft(const Hand *hand);
+
+/* Dealer draws until 17 or more (stands on soft 17) */
+void play_dealer_hand(Hand *dealer, Shoe *shoe);
+/* +1 player wins, 0 push, -1 player loses */
+int hand_outcome(const Hand *player, const Hand *dealer);
+void hand_to_string(const Hand *hand, char *buf, size_t bufsize);
+
+#endif /* BLACKJACK_H */
@@ -0,0 +1,73 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stddef.h>
+
+#include "proto.h"
+
+/*
+ * Spectator fan-out. A table appends each public event to its Feed once per
+ * framing; at the phase boundary each framing's bytes become one Broadcast,
+ * and every spectator's Watch queue takes a reference to it rather than a
+ * copy. Spectator sockets are only ever written without blocking: whatever
+ * a socket won't take stays queued until it drains, and a spectator more
+ * than WATCH_BACKLOG broadcasts behind is dropped, so nobody watching can
+ * hold up the players.
+ *
+ * Everything here belongs to the shard that owns the table.
+ */
+
+#define FEED_SIZE      2048
+#define WATCH_BACKLOG  64
+
+typedef struct Broadcast {
+    int refs;
+    size_t len;
+    char data[];
+} Broadcast;
+
+typedef struct Feed {
+    char text[FEED_SIZE];
+    size_t text_len;
+    char binary[FEED_SIZE];
+    size_t binary_len;
+    int seat;                 /* seat the last SEAT marker named, -1 if none */
+} Feed;
+
+typedef struct Watch {
+    Broadcast *queue[WATCH_BACKLOG];
+    int head;
+    int count;
+    size_t sent;              /* bytes of queue[head] already written */
+} Watch;
+
+/* ---------- feed ---------- */
+
+void feed_init(Feed *f);
+/* Enough room for one more message of each framing */
+int feed_has_room(const Feed *f);
+/* Append one event, encoded once in each framing */
+void feed_send(Feed *f, int op);
+void feed_send_int(Feed *f, int op, int value);
+void feed_send_card(Feed *f, int op, Card c);
+void feed_send_hand(Feed *f, int op, const Hand *h);
+
+/* ---------- broadcasts ---------- */
+
+/* A copy of data holding one reference, the caller's; NULL if out of memory */
+Broadcast *broadcast_new(const char *data, size_t len);
+/* Drop the caller's reference once b has been handed out */
+void broadcast_release(Broadcast *b);
+
+/* ---------- spectators ---------- */
+
+void watch_init(Watch *w);
+/* Queue a reference to b and write what the socket takes now. -1 if the
+ * spectator is too far behind or the socket failed: drop them. */
+int watch_push(Watch *w, int fd, Broadcast *b);
+/* Write queued broadcasts until the socket is full; -1 on failure */
+int watch_flush(Watch *w, int fd);
+/* Drop every queued reference */
+void watch_clear(Watch *w);
+
+#endif /* BROADCAST_H */
@@ -0,0 +1,180 @@
+#ifndef CONN_H
+#define CONN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "blackjack.h"
+#include "pool.h"
+#include "proto.h"
+#include "rxbuf.h"
+#include "timerwheel.h"
+
+#define BUFFER_SIZE 512
+#define OUTBUF_SIZE 1024
+
+/* Output a player's socket has not taken yet waits in a backlog. Above the
+ * high-water mark they sit out new rounds until it drains below the low one;
+ * past the budget, or with no progress for conn_stall_timeout_ms, they are
+ * evicted. Nothing ever blocks on a slow reader. */
+#define CONN_TX_BUDGET (64 * 1024)
+#define CONN_TX_HIGH   (32 * 1024)
+#define CONN_TX_LOW    (8 * 1024)
+
+/* Received buffers (io_uring) a connection may hold when its multishot
+ * receive brings more than rx has room for; the receive is cancelled and
+ * later ones take no more than fits, so unread input waits in the socket */
+#define CONN_RX_HELD 16
+
+struct Table;
+struct Uring;
+struct ShmLink;
+
+/* io_uring user_data: a PlayerConn pointer with the request kind in the low bits;
+ * CONN_IO_NONE alone marks a request whose completion needs no handling */
+#define CONN_IO_NONE 0
+#define CONN_IO_RECV 1
+#define CONN_IO_SEND 2
+#define CONN_IO_MASK 3
+
+typedef enum {
+    PLAYER_WAITING,   /* seated, waits for the next round to be dealt */
+    PLAYER_IN_ROUND,  /* dealt in, waiting for its turn */
+    PLAYER_DECIDING,  /* prompted, waiting for HIT / STAND */
+    PLAYER_DONE       /* finished acting this round */
+} PlayerState;
+
+typedef struct PlayerConn {
+    int socket_fd;
+    struct ShmLink *shm;     /* a local bot's channel; NULL over TCP */
+    Hand hand;
+    int active;              /* 1 = connected, 0 = retired */
+    int seat;                /* seat index at its table, -1 if unseated */
+    PlayerState state;
+    struct Table *table;
+
+    RxBuf rx;                /* received bytes not yet parsed */
+    int binary;              /* 1 once PROTO BINARY has been negotiated */
+
+    char out[OUTBUF_SIZE];   /* messages queued for the current phase */
+    size_t out_len;
+    int corked;              /* TCP_CORK held across an overflow flush */
+
+    Timer deadline;          /* armed while deciding; expiry stands for them */
+    int missed_turns;        /* deadlines missed in a row */
+    uint64_t prompted_ns;    /* stats_clock() at the last prompt */
+
+    char *backlog;           /* CONN_TX_BUDGET bytes once first needed */
+    size_t backlog_off;      /* unsent bytes are [off, off + len) */
+    size_t backlog_len;
+    int congested;           /* above the high-water mark */
+    int evict;               /* over budget; the stall timer drops them */
+    Timer stall;             /* armed while the backlog is not draining */
+    uint64_t stall_ns;       /* stats_clock() when the backlog began */
+
+    int ring_ops;            /* io_uring requests in flight that name it */
+    size_t tx_inflight;      /* backlog bytes an io_uring send is writing */
+    int tx_listed;           /* waiting for conn_submit_sends() */
+    struct PlayerConn *next_tx;
+    int stalled;             /* (io_uring) a send outlived its batch */
+    int rx_closed;           /* (io_uring, shm) input ended or failed */
+    int rx_armed;            /* (io_uring) a receive is posted */
+    int rx_capped;           /* (io_uring) ran ahead once: one-shot receives */
+    unsigned short rx_held[CONN_RX_HELD];      /* buffer ids, oldest first */
+    unsigned short rx_held_len[CONN_RX_HELD];
+    int rx_held_n;
+    size_t rx_held_off;      /* bytes of rx_held[0] already taken */
+    struct PlayerConn *next_parked;     /* (io_uring) out of buffers */
+    struct PlayerConn **pprev_parked;   /* set while parked */
+
+    struct Watch *watch;     /* set once spectating: broadcasts not yet sent */
+    struct PlayerConn *next_spectator;
+    struct PlayerConn **pprev_spectator;
+
+    struct PlayerConn *next_retired;
+} PlayerConn;
+
+/* Set once at startup: cork the socket when a phase overflows out[] */
+extern int conn_use_cork;
+/* Set once at startup: how long a backlog may sit without draining (0 = forever) */
+extern int conn_stall_timeout_ms;
+
+/* The calling thread's wheel, for stall timers; each connection's stall
+ * timer must have been timer_init()ed with the owner's handler */
+void conn_set_timers(TimerWheel *w);
+
+ssize_t send_all(int fd, const char *buf, size_t len);
+/* One argument-less text message straight to a socket that has no
+ * connection yet (SERVER_FULL); 0 ok, -1 on failure */
+int send_simple(int fd, int op);
+
+/* Queue one message in the connection's negotiated framing; nothing hits
+ * the socket until conn_flush() */
+void conn_send(PlayerConn *pc, int op);
+void conn_send_int(PlayerConn *pc, int op, int value);
+void conn_send_card(PlayerConn *pc, int op, Card c);
+void conn_send_hand(PlayerConn *pc, int op, const Hand *h);
+/* Send everything queued with a single non-blocking send(); what the socket
+ * won't take joins the backlog. Called at phase boundaries. -1 if the
+ * connection failed or is being evicted. */
+int conn_flush(PlayerConn *pc);
+/* The socket has room again (EPOLLOUT): send what the backlog holds.
+ * -1 if the connection failed. */
+int conn_drain(PlayerConn *pc);
+/* Give up the backlog to be sent some other way: *data points at its bytes
+ * until pc next sends. Returns how many there are. */
+size_t conn_take_backlog(PlayerConn *pc, const char **data);
+
+/* ---------- io_uring ---------- */
+
+/* Set on a shard thread that drives its sockets through a ring: flushed
+ * output is sent by requests batched with conn_submit_sends(), and input
+ * arrives by completion rather than recv(). NULL (the default) is epoll. */
+void conn_set_ring(struct Uring *u);
+/* Post the connection's next receive (none while rx is full); -1 if the
+ * ring is full */
+int conn_start_recv(PlayerConn *pc);
+/* Post receives again for connections whose last one found no provided
+ * buffer, once any has been given back since */
+void conn_resume_recvs(void);
+/* Queue one send per connection with output waiting; returns how many */
+int conn_submit_sends(void);
+/* Completions. recv: 1 input arrived, -1 input ended, 0 nothing to do;
+ * send: -1 if the connection failed */
+int conn_recv_done(PlayerConn *pc, int res, unsigned flags);
+int conn_send_done(PlayerConn *pc, int res);
+
+/* ---------- shared memory ---------- */
+
+/* Carry the connection's messages through a shared-memory channel set up
+ * with the bot on socket_fd (see shm.h); the socket is kept only to see the
+ * bot hang up, which must then set rx_closed. 0 ok, -1 on failure. */
+int conn_attach_shm(PlayerConn *pc);
+
+/* Next player command (non-blocking). Control messages such as PROTO are
+ * handled here and never returned. 1 = *m holds a command, 0 = nothing
+ * complete yet, -1 = disconnect */
+int conn_recv_msg(PlayerConn *pc, ProtoMsg *m);
+
+/* For a player who is not acting: read what has arrived and handle leading
+ * control messages, leaving any decision buffered for their turn.
+ * -1 on disconnect, 1 if they asked to WATCH instead, 0 otherwise */
+int conn_pump(PlayerConn *pc);
+
+/* For a spectator: read and throw away whatever has arrived.
+ * -1 on disconnect, 0 otherwise */
+int conn_discard_input(PlayerConn *pc);
+
+/* Sessions are allocated from the calling thread's pool, if it set one;
+ * every call below must come from the thread that owns the connection */
+void conn_set_pool(Pool *p);
+/* A zeroed session, or NULL */
+PlayerConn *conn_new(void);
+/* Free a session that was never retired (its socket is the caller's) */
+void conn_free(PlayerConn *pc);
+
+/* Close the socket now, free the connection at the next conn_reap() */
+void conn_retire(PlayerConn *pc);
+int conn_reap(void);   /* returns the number of connections freed */
+
+#endif /* CONN_H */
@@ -0,0 +1,41 @@
+#ifndef CONNQ_H
+#define CONNQ_H
+
+#include <stddef.h>
+#include <netinet/in.h>
+
+/* A freshly accepted socket on its way to a shard */
+typedef struct {
+    int fd;
+    struct sockaddr_in addr;
+    int local;     /* from --shm-socket: a bot on this host */
+} PendingConn;
+
+typedef struct {
+    size_t seq;
+    PendingConn item;
+} ConnQueueCell;
+
+/*
+ * Bounded lock-free multi-producer / multi-consumer queue (Vyukov style).
+ * The accept thread produces; the owning shard and any idle shard that is
+ * stealing work consume.
+ */
+typedef struct {
+    ConnQueueCell *cells;
+    size_t mask;
+    char pad0[64];
+    size_t head;   /* next slot to dequeue */
+    char pad1[64];
+    size_t tail;   /* next slot to enqueue */
+    char pad2[64];
+} ConnQueue;
+
+/* capacity is rounded up to a power of two */
+int connq_init(ConnQueue *q, size_t capacity);
+void connq_destroy(ConnQueue *q);
+int connq_push(ConnQueue *q, const PendingConn *pc);   /* 0 ok, -1 full */
+int connq_pop(ConnQueue *q, PendingConn *out);         /* 0 ok, -1 empty */
+size_t connq_depth(const ConnQueue *q);                /* approximate */
+
+#endif /* CONNQ_H */
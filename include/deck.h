@@ -2,24 +2,33 @@
 #define DECK_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #define DECK_SIZE 52
 
-typedef struct 
-{
-    int rank;  /* 1–13 (1=Ace, 11=J, 12=Q, 13=K) */
-    int suit;  /* 0–3 (Clubs, Diamonds, Hearts, Spades) */
-} Card;
+/*
+ * One card in one byte: rank << 2 | suit, the same byte the binary protocol
+ * puts on the wire. A shoe of 8 decks fits in 416 bytes.
+ *   rank 1–13 (1=Ace, 11=J, 12=Q, 13=K)
+ *   suit 0–3  (Clubs, Diamonds, Hearts, Spades)
+ */
+typedef uint8_t Card;
 
-typedef struct 
-{
-    Card cards[DECK_SIZE];
-    int top;  /* index of next card to deal */
-} Deck;
+static inline Card card_make(int rank, int suit) {
+    return (Card)((rank << 2) | (suit & 3));
+}
+static inline int card_rank(Card c) { return c >> 2; }
+static inline int card_suit(Card c) { return c & 3; }
 
-void deck_init(Deck *deck);
-void deck_shuffle(Deck *deck);
-Card deck_deal(Deck *deck);
-const char *card_to_string(const Card *card, char *buf, size_t bufsize);
+/* "AC" .. "KS", indexed by the card byte; unused bytes are "" */
+extern const char card_names[64][4];
+/* Length of card_names[c]: 3 for tens, 2 otherwise, 0 if unused */
+static inline size_t card_name_len(Card c) {
+    return card_names[c & 63][2] ? 3 : (card_names[c & 63][0] ? 2 : 0);
+}
+
+/* Write one ordered 52-card deck into cards[0..DECK_SIZE) */
+void deck_fill(Card *cards);
+const char *card_to_string(Card card, char *buf, size_t bufsize);
 
 #endif /* DECK_H */
@@ -0,0 +1,86 @@
+#ifndef EV_H
+#define EV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blackjack.h"
+#include "deck.h"
+#include "strategy.h"
+
+/*
+ * Exact, composition-dependent expected values for this table's rules.
+ *
+ * Cards are counted by point value: counts[1] aces, counts[2..9], counts[10]
+ * every ten-valued card. Player and dealer draws come out of the same
+ * counts, and the dealer plays exactly like play_dealer_hand(): hit below 17
+ * by hand_value(), no peek, every win paying 1:1.
+ *
+ * The recursion memoizes on the packed composition plus the hand's
+ * (hard total, holds an ace) state, in open-addressed tables private to one
+ * EvCtx, so each thread works on its own context and needs no locks.
+ */
+
+#define EV_RANKS 10
+#define EV_MAX_DECKS 8    /* counts must pack into 64 bits */
+
+typedef struct {
+    int counts[EV_RANKS + 1];   /* [0] unused */
+    int total;
+} EvComp;
+
+/* Open-addressed map from (composition, hand state) to nvals doubles */
+typedef struct {
+    uint64_t *comps;
+    uint32_t *states;         /* 0 marks an empty slot */
+    double *vals;
+    size_t cap;               /* power of two */
+    size_t used;
+    int nvals;
+} EvMap;
+
+typedef struct {
+    EvMap dealer;             /* DEALER_OUTCOMES probabilities */
+    EvMap player;             /* best EV */
+} EvCtx;
+
+typedef struct {
+    double stand;
+    double hit;               /* hitting, then playing on optimally; = stand on 21 */
+} EvResult;
+
+void ev_comp_decks(EvComp *c, int ndecks);
+/* Take one card out; -1 if there is none of that rank left */
+int ev_comp_remove(EvComp *c, Card card);
+
+/* 0 ok, -1 out of memory */
+int ev_init(EvCtx *ctx);
+void ev_free(EvCtx *ctx);
+
+/* Dealer outcome odds with `up` showing and the hole card still in c */
+void ev_dealer_odds(EvCtx *ctx, const EvComp *c, Card up, double *odds);
+/* Stand/hit EVs for player against up; c holds every card not yet seen.
+ * Returns 0 if the table would not let the player hit (21 or more). */
+int ev_hand(EvCtx *ctx, const EvComp *c, const Hand *player, Card up, EvResult *out);
+
+/* ---------- whole-round analysis ---------- */
+
+/* One starting deal: player ranks a <= b against up card `up` */
+typedef struct {
+    int a, b, up;
+    double prob;              /* chance of this deal, either card order */
+    EvResult ev;
+} EvDeal;
+
+#define EV_DEALS (EV_RANKS * (EV_RANKS + 1) / 2 * EV_RANKS)
+
+typedef struct {
+    EvDeal deals[EV_DEALS];
+    int ndeals;               /* deals the composition can produce */
+    double ev;                /* per round, playing every deal optimally */
+} EvAnalysis;
+
+/* Solve every starting deal from c, spread over nthreads; 0 ok, -1 on failure */
+int ev_analyze(const EvComp *c, int nthreads, EvAnalysis *out);
+
+#endif /* EV_H */
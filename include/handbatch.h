@@ -0,0 +1,42 @@
+#ifndef HANDBATCH_H
+#define HANDBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blackjack.h"
+
+/*
+ * Many hands at once, structure-of-arrays: lane i of every array is hand i.
+ * The kernels work on 16 (SSE2) or 32 (AVX2) lanes per instruction and are
+ * picked once at runtime from what the CPU supports; every kernel agrees
+ * bit for bit with hand_add_card() and the hand_* queries in blackjack.c.
+ *
+ * The caller owns the arrays; each must hold n bytes.
+ */
+typedef struct {
+    uint8_t *count;
+    uint8_t *hard;            /* total with every ace counted as 1 */
+    uint8_t *aces;
+    size_t n;
+} HandBatch;
+
+/* Per-lane results, each 0/1 except value */
+typedef struct {
+    uint8_t *value;
+    uint8_t *soft;
+    uint8_t *bust;
+    uint8_t *blackjack;
+} HandBatchEval;
+
+void hand_batch_clear(HandBatch *b);
+/* Copy b->n ordinary hands into the batch */
+void hand_batch_load(HandBatch *b, const Hand *hands);
+/* Deal cards[i] to lane i; a full lane drops its card like hand_add_card() */
+void hand_batch_add(HandBatch *b, const Card *cards);
+void hand_batch_eval(const HandBatch *b, HandBatchEval *out);
+
+/* "avx2", "sse2" or "scalar": the kernel hand_batch_* dispatches to */
+const char *hand_batch_kernel(void);
+
+#endif /* HANDBATCH_H */
@@ -0,0 +1,142 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blackjack.h"
+#include "shoe.h"
+
+/*
+ * Append-only round journal. Every finished round becomes one compact
+ * binary record: the table's shoe seed and where in its shoes the round
+ * began, every card dealt in shoe order, each seat's decisions and the
+ * results. That is enough to re-deal the round from the seed alone and
+ * check every card and result (see replay.c).
+ *
+ * File layout: a JournalHeader, then records back to back. Each record is
+ * a JournalRecord followed by ncards cards, nactions actions and one result
+ * per seat dealt in, in seat order. Integers are in host byte order.
+ *
+ * Tables hand records to a Journal, whose writer thread takes everything
+ * appended since its last pass and writes it with one write() and one
+ * fdatasync(): a group commit every sync_ms at most, off the game loop. A
+ * crash loses at most the rounds of the last window; a torn record at the
+ * end is cut off when the journal is next opened.
+ */
+
+#define JOURNAL_MAGIC   0x4a524a42u   /* "BJRJ" */
+#define JOURNAL_VERSION 1
+
+/* Seats fit one byte of flags and four bits of an action */
+#define JOURNAL_MAX_SEATS   8
+#define JOURNAL_MAX_CARDS   ((JOURNAL_MAX_SEATS + 1) * MAX_HAND_CARDS)
+#define JOURNAL_MAX_ACTIONS (JOURNAL_MAX_SEATS * MAX_HAND_CARDS)
+#define JOURNAL_MAX_RECORD  (sizeof(JournalRecord) + JOURNAL_MAX_CARDS + \
+                             JOURNAL_MAX_ACTIONS + JOURNAL_MAX_SEATS)
+
+/* Records handed over and not yet taken by the writer; appends wait while
+ * this much is already pending */
+#define JOURNAL_BUF_SIZE (1024 * 1024)
+
+typedef struct JournalHeader {
+    uint32_t magic;
+    uint32_t version;
+} JournalHeader;
+
+typedef struct JournalRecord {
+    uint16_t len;             /* the whole record, these fields included */
+    uint8_t ndecks;           /* shoe shape the seed was dealt with */
+    uint8_t seats;            /* bit i: seat i was dealt in */
+    uint8_t ncards;
+    uint8_t nactions;
+    uint16_t top;             /* the round's first card: its place in the shoe */
+    uint32_t table;
+    uint32_t round;           /* rounds the table dealt before this one */
+    uint64_t seed;            /* the table's shoe seed */
+    uint64_t shuffles;        /* shoes drawn from the seed, this one included */
+    uint64_t time_ms;         /* wall clock when dealt */
+} JournalRecord;
+
+/* An action is seat << 4 | one of these */
+#define JOURNAL_ACT_HIT     1
+#define JOURNAL_ACT_STAND   2
+#define JOURNAL_ACT_TIMEOUT 3     /* stood for by the deadline */
+#define JOURNAL_ACT_LEFT    4     /* disconnected, evicted or went to WATCH */
+
+/* A result is a ProtoResult code, or this for a seat that left before the end */
+#define JOURNAL_RES_GONE    3
+
+#define JOURNAL_ACTION(seat, act) ((uint8_t)((seat) << 4 | (act)))
+#define JOURNAL_SEAT(a)           ((a) >> 4)
+#define JOURNAL_KIND(a)           ((a) & 15)
+
+/* ---------- building a record ---------- */
+
+/* The record of a table's current round, filled in as it is played */
+typedef struct JournalRound {
+    JournalRecord rec;
+    Card cards[JOURNAL_MAX_CARDS];
+    uint8_t actions[JOURNAL_MAX_ACTIONS];
+    uint8_t gone;             /* seats that left before the results */
+    int open;                 /* dealt, and not yet handed to the journal */
+} JournalRound;
+
+/* Call after shoe_begin_round() and before the first card is dealt */
+void journal_round_begin(JournalRound *r, int table, uint32_t round, uint64_t seed,
+                         const Shoe *shoe, unsigned seats);
+
+static inline void journal_card(JournalRound *r, Card c) {
+    if (r->open && r->rec.ncards < JOURNAL_MAX_CARDS) r->cards[r->rec.ncards++] = c;
+}
+
+static inline void journal_action(JournalRound *r, int seat, int act) {
+    if (!r->open || r->rec.nactions == JOURNAL_MAX_ACTIONS) return;
+    r->actions[r->rec.nactions++] = JOURNAL_ACTION(seat, act);
+    if (act == JOURNAL_ACT_LEFT) r->gone |= (uint8_t)(1u << seat);
+}
+
+/* Close the round with each dealt-in seat's result, in seat order, and lay
+ * its record out in buf (JOURNAL_MAX_RECORD bytes); the record's length */
+size_t journal_round_encode(JournalRound *r, const uint8_t *results, char *buf);
+
+/* ---------- writing ---------- */
+
+typedef struct Journal {
+    int fd;
+    int sync_ms;              /* group-commit window */
+    pthread_mutex_t lock;
+    pthread_cond_t work;      /* records were appended */
+    pthread_cond_t room;      /* the writer took a batch: fill is empty */
+    char *bufs[2];
+    char *fill;               /* appended since the writer's last pass */
+    size_t fill_len;
+    pthread_t thread;
+} Journal;
+
+/* Open (or create) the journal at path, cut off a torn last record and
+ * start the writer thread. 0 ok, -1 on failure (reported). */
+int journal_open(Journal *j, const char *path, int sync_ms);
+
+/* Close the round with each dealt-in seat's result, in seat order, and
+ * append it. Returns 1 if it had to wait for the writer to make room. */
+int journal_round_end(Journal *j, JournalRound *r, const uint8_t *results);
+
+/* ---------- reading ---------- */
+
+/* One record read back: its fixed part, and the rest where it lies */
+typedef struct JournalEntry {
+    JournalRecord rec;
+    const Card *cards;
+    const uint8_t *actions;
+    const uint8_t *results;   /* one per seat dealt in */
+} JournalEntry;
+
+/* 0 if buf starts with a journal header this code reads, -1 if not */
+int journal_check_header(const char *buf, size_t len);
+/* The record at *off of a journal buf[0, len): 1 read (and *off moved past
+ * it), 0 at the end, -1 if what is left is not a whole record */
+int journal_next(const char *buf, size_t len, size_t *off, JournalEntry *e);
+
+#endif /* JOURNAL_H */
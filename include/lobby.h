@@ -0,0 +1,40 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include "table.h"
+
+/*
+ * Where a shard's new connections sit down. Every table with a free seat is
+ * filed in a bucket by how many players it holds; full tables are in none.
+ * Seating and leaving move a table between buckets in O(1), and placing a
+ * player looks at no more than MAX_PLAYERS bucket heads, however many
+ * tables there are. The fullest table with room wins, which keeps tables
+ * packed and leaves the empty ones for bursts.
+ *
+ * All tables share one set of rules, so there is one index per shard.
+ * A lobby belongs to its shard's thread.
+ */
+
+/* A table about to deal to fewer players than this joins a fuller one */
+#define LOBBY_MERGE_BELOW 2
+/* Busy tables passed over per bucket before a merge gives up on it */
+#define LOBBY_MERGE_PROBES 4
+
+typedef struct Lobby {
+    Table *open[MAX_PLAYERS];     /* by seated count */
+} Lobby;
+
+void lobby_init(Lobby *l);
+/* File a new table; from then on seating and leaving keep it filed */
+void lobby_add(Lobby *l, Table *t);
+/* Refile t after its seated count changed (table.c does this) */
+void lobby_update(Table *t);
+
+/* The fullest table with a free seat, NULL if every table is full */
+Table *lobby_place(Lobby *l);
+/* For a table about to deal to fewer than LOBBY_MERGE_BELOW players: an
+ * idle table (between rounds or in its lobby wait) at least as full with
+ * room for all of them, or NULL to stay */
+Table *lobby_merge_target(Lobby *l, Table *t);
+
+#endif /* LOBBY_H */
@@ -0,0 +1,34 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/*
+ * Fixed-size object pool. Objects are carved out of slabs of POOL_SLAB_OBJS
+ * at a time and never handed back to malloc until pool_destroy(); a freed
+ * object goes on an intrusive free list, so allocating and freeing are both
+ * O(1) and a busy server stops calling malloc once it reaches its peak.
+ *
+ * A pool belongs to one thread.
+ */
+
+#define POOL_SLAB_OBJS 256
+
+struct PoolSlab;
+
+typedef struct Pool {
+    size_t size;              /* object size, rounded up for alignment */
+    void *free;               /* free objects, linked through their first word */
+    struct PoolSlab *slabs;
+    size_t live;              /* objects handed out */
+    size_t capacity;          /* objects in all slabs */
+} Pool;
+
+void pool_init(Pool *p, size_t size);
+/* A zeroed object, or NULL if a new slab was needed and malloc failed */
+void *pool_alloc(Pool *p);
+void pool_free(Pool *p, void *obj);
+/* Free every slab; objects still live are gone with them */
+void pool_destroy(Pool *p);
+
+#endif /* POOL_H */
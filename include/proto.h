@@ -0,0 +1,88 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <stddef.h>
+
+#include "blackjack.h"
+#include "deck.h"
+#include "strategy.h"
+
+/*
+ * Wire protocol shared by server and client.
+ *
+ * Text (default): one line per message, e.g. "DEALER_UP AH\n".
+ * Binary (opt-in): the client sends "PROTO BINARY" after WELCOME and frames
+ * every command after it; the server answers "PROTO BINARY" as its last text
+ * line and frames everything after that:
+ *
+ *     [u8 len][u8 opcode][len - 1 payload bytes]
+ *
+ * Cards travel as one byte, (rank << 2) | suit. Values and seats are one byte.
+ *
+ * A player who sends WATCH gives up their seat and gets the table's public
+ * events instead: the same messages a player sees, each run about one seat
+ * introduced by SEAT n.
+ */
+
+typedef enum {
+    OP_NONE = 0,
+    OP_WELCOME,          /* u8 seat (1-based) */
+    OP_SERVER_FULL,
+    OP_DEALER_UP,        /* card */
+    OP_YOUR_HAND,        /* cards */
+    OP_YOUR_TURN,
+    OP_HAND,             /* cards */
+    OP_PROMPT,
+    OP_HIT,              /* server: card dealt; client: take a card */
+    OP_STAND,            /* server: u8 value;   client: stand */
+    OP_BUST,             /* u8 value */
+    OP_BLACKJACK,
+    OP_DEALER_HAND,      /* cards */
+    OP_DEALER_VALUE,     /* u8 value */
+    OP_PLAYER_VALUE,     /* u8 value */
+    OP_RESULT,           /* u8 ProtoResult */
+    OP_ROUND_END,
+    OP_UNKNOWN_COMMAND,
+    OP_PROTO,            /* negotiation, text only */
+    OP_HINT,             /* server: u8 Hint;    client: ask for one */
+    OP_SEAT,             /* spectators: u8 seat (1-based) the next events are about */
+    OP_WATCH,            /* client: become a spectator; server: acknowledged */
+    OP_COUNT
+} ProtoOp;
+
+typedef enum {
+    RESULT_LOSE = 0,
+    RESULT_WIN  = 1,
+    RESULT_PUSH = 2
+} ProtoResult;
+
+#define PROTO_MAX_MSG 128   /* largest encoded message, text or binary */
+
+/* A decoded message, whichever framing it arrived in */
+typedef struct {
+    int op;                 /* ProtoOp, OP_NONE if not recognised */
+    int value;              /* seat, hand value or ProtoResult */
+    int ncards;
+    Card cards[MAX_HAND_CARDS];
+    const char *arg;        /* text only: everything after the keyword */
+} ProtoMsg;
+
+unsigned char proto_card_byte(Card c);
+Card proto_byte_card(unsigned char b);
+
+/* Keyword lookup (binary search over a sorted table), OP_NONE if unknown */
+int proto_text_op(const char *word, size_t len);
+const char *proto_op_name(int op);
+
+/* Encoders: append one message, return the bytes written (0 if no room) */
+size_t proto_put_simple(char *buf, size_t room, int binary, int op);
+size_t proto_put_int(char *buf, size_t room, int binary, int op, int value);
+size_t proto_put_card(char *buf, size_t room, int binary, int op, Card c);
+size_t proto_put_hand(char *buf, size_t room, int binary, int op, const Hand *h);
+
+/* Decoders. The text decoder splits the line in place. Both return 0 on
+ * success, -1 on a malformed message (m->op is still filled in if known). */
+int proto_decode_line(char *line, ProtoMsg *m);
+int proto_decode_frame(const unsigned char *frame, size_t len, ProtoMsg *m);
+
+#endif /* PROTO_H */
@@ -0,0 +1,42 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * Small, fast, seedable generators. Every Shoe, table and simulation thread
+ * owns its own Rng, so nothing is shared between threads and any shuffle can
+ * be reproduced from its seed.
+ */
+typedef enum {
+    RNG_XOSHIRO256SS,   /* default: 256-bit state, jump() = 2^128 steps */
+    RNG_PCG32           /* 64-bit state + stream, jump() = 2^48 steps */
+} RngKind;
+
+#define RNG_DEFAULT RNG_XOSHIRO256SS
+
+typedef struct {
+    RngKind kind;
+    uint64_t s[4];      /* xoshiro state, or PCG state in s[0] and increment in s[1] */
+} Rng;
+
+/* Expand a 64-bit seed into a full state (splitmix64) */
+void rng_seed(Rng *r, RngKind kind, uint64_t seed);
+
+uint64_t rng_next64(Rng *r);
+uint32_t rng_next32(Rng *r);
+
+/* Uniform in [0, n) without modulo bias (Lemire's multiply-and-reject) */
+uint32_t rng_bounded(Rng *r, uint32_t n);
+
+/* Advance as if by a huge number of calls; streams taken between jumps
+ * never overlap */
+void rng_jump(Rng *r);
+
+/* Hand out an independent stream: child starts where parent is, then the
+ * parent jumps past everything the child will ever use */
+void rng_split(Rng *parent, Rng *child);
+
+int rng_kind_from_name(const char *name, RngKind *kind);   /* 0 ok, -1 unknown */
+
+#endif /* RNG_H */
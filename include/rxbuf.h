@@ -0,0 +1,50 @@
+#ifndef RXBUF_H
+#define RXBUF_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define RXBUF_SIZE 2048
+
+/*
+ * Per-connection receive buffer. Bytes are pulled from the socket in large
+ * chunks and complete lines are handed out in place (the '\n' becomes a
+ * '\0'), so one recv() usually yields several commands and none of them is
+ * copied. Unconsumed bytes slide back to the front when the tail fills up.
+ * The same buffer can switch to length-prefixed binary frames mid-stream.
+ */
+typedef struct {
+    char data[RXBUF_SIZE];
+    size_t start;    /* first unconsumed byte */
+    size_t scanned;  /* [start, scanned) is known to hold no '\n' */
+    size_t end;      /* one past the last received byte */
+} RxBuf;
+
+void rxbuf_init(RxBuf *rb);
+
+/* One recv() into the free space: >0 bytes read, 0 peer closed, -1 error
+ * (errno set, EAGAIN on a non-blocking socket with nothing to read) */
+ssize_t rxbuf_fill(RxBuf *rb, int fd, int flags);
+
+/* Free space once unconsumed bytes slide to the front */
+size_t rxbuf_room(RxBuf *rb);
+
+/* Bytes that were received elsewhere (an io_uring completion); returns how
+ * many fit, which is fewer than len only if unconsumed input fills it */
+size_t rxbuf_append(RxBuf *rb, const char *buf, size_t len);
+
+/* Next complete line, NUL-terminated with any trailing '\r' removed, or NULL.
+ * The pointer stays valid until the next rxbuf_fill(). A line that would not
+ * fit in the buffer is returned truncated. */
+char *rxbuf_next_line(RxBuf *rb, size_t *len);
+
+/* Look at the next complete line without consuming it (not NUL-terminated,
+ * *len excludes the line ending), or NULL */
+const char *rxbuf_peek_line(RxBuf *rb, size_t *len);
+
+/* Length-prefixed frames, [u8 len][len bytes]: returns the len bytes and
+ * consumes the frame, or NULL if it has not fully arrived */
+unsigned char *rxbuf_next_frame(RxBuf *rb, size_t *len);
+const unsigned char *rxbuf_peek_frame(const RxBuf *rb, size_t *len);
+
+#endif /* RXBUF_H */
@@ -0,0 +1,63 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <pthread.h>
+
+#include "connq.h"
+#include "lobby.h"
+#include "pool.h"
+#include "stats.h"
+#include "table.h"
+#include "timerwheel.h"
+#include "uring.h"
+
+#define SHARD_QUEUE_SIZE 4096
+
+/* Set once at startup: shards drive their sockets through io_uring where
+ * the kernel allows, and fall back to epoll where it doesn't */
+extern int shard_use_uring;
+
+/*
+ * A shard is one worker thread with its own epoll loop. It owns its tables,
+ * their shoes and the PRNG that seeds them; nothing in a shard is touched by
+ * another thread except the incoming connection queue and the load counters.
+ */
+typedef struct Shard {
+    int id;
+    int epfd;
+    int wake_fd;              /* eventfd, poked when work is queued */
+    Uring *ring;              /* NULL when running on epoll */
+    pthread_t thread;
+
+    ConnQueue incoming;       /* accepted sockets waiting to be seated */
+    int idle;                 /* 1 while blocked in epoll_wait */
+    int conn_count;           /* connections this shard owns */
+    Pool sessions;            /* their PlayerConns */
+
+    Table **tables;
+    int table_count;
+    int table_cap;
+    Lobby lobby;              /* those with a free seat, by players seated */
+    Table *run_head;          /* tables ready to deal their next round */
+    Table *run_tail;
+    TimerWheel timers;        /* turn deadlines and lobby waits */
+
+    Rng rng;                  /* seeds this shard's tables */
+    ServerStats stats;        /* written by this shard only */
+
+    struct Shard *peers;      /* every shard, for work stealing */
+    int npeers;
+} Shard;
+
+/* rng is this shard's own stream (see rng_split()) */
+int shard_init(Shard *s, int id, Shard *peers, int npeers, const Rng *rng);
+int shard_start(Shard *s);
+
+/* Accept-thread side: queue a socket for this shard; 0 ok, -1 queue full */
+int shard_submit(Shard *s, const PendingConn *pc);
+void shard_wake(Shard *s);
+
+/* Load seen by the accept thread when picking a shard */
+int shard_load(const Shard *s);
+
+#endif /* SHARD_H */
@@ -0,0 +1,73 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Shared-memory transport for bots on the same host as the server. A bot
+ * connects to the server's Unix socket (--shm-socket) and is sent, over
+ * it, a memfd holding one ShmChannel and two eventfd doorbells. From then
+ * on the protocol's messages (text or frames, exactly as on TCP) travel
+ * through the channel's two single-producer / single-consumer byte rings,
+ * with no system call on either side; the socket stays open only so that
+ * each end sees the other hang up.
+ *
+ * A doorbell is rung only for a peer that said it was going to sleep
+ * (shm_idle()) or is waiting for room, so a busy pair exchanges messages
+ * without the kernel at all.
+ */
+
+#define SHM_MAGIC     0x424a4b31u   /* "BJK1" */
+#define SHM_RING_SIZE (16 * 1024)   /* bytes each way; a power of two */
+
+typedef struct ShmRing {
+    uint32_t head;            /* bytes consumed; written by the reader */
+    uint32_t reader_asleep;   /* ring its doorbell on the next write */
+    char pad0[56];
+    uint32_t tail;            /* bytes produced; written by the writer */
+    uint32_t writer_blocked;  /* ring its doorbell when room is made */
+    char pad1[56];
+    char data[SHM_RING_SIZE];
+} ShmRing;
+
+typedef struct ShmChannel {
+    uint32_t magic;           /* SHM_MAGIC once the server has set it up */
+    uint32_t ring_size;
+    char pad[56];
+    ShmRing up;               /* bot to server */
+    ShmRing down;             /* server to bot */
+} ShmChannel;
+
+/* One end of a channel */
+typedef struct ShmLink {
+    ShmChannel *ch;
+    ShmRing *rx;              /* what this end reads */
+    ShmRing *tx;              /* what it writes */
+    int bell;                 /* eventfd the peer rings: input, or room */
+    int peer_bell;
+} ShmLink;
+
+/* Server side: a listening Unix socket at path (a stale one is replaced) */
+int shm_listen(const char *path, int backlog);
+/* Server side: set up a channel for the bot on sock and send it over.
+ * 0 ok, -1 (errno set) on failure. */
+int shm_link_create(ShmLink *l, int sock);
+/* Bot side: receive and map the channel the server sent on sock. 0 ok,
+ * -1 on failure, with errno EAGAIN if nothing has arrived yet and EPROTO
+ * if the server answered with something else (SERVER_FULL). */
+int shm_link_accept(ShmLink *l, int sock);
+void shm_link_close(ShmLink *l);
+
+/* Write what fits of buf; returns the bytes taken, fewer than len only if
+ * the ring is full, in which case the reader rings once it makes room */
+size_t shm_send(ShmLink *l, const void *buf, size_t len);
+/* Bytes that can be read in place at *p (possibly not all of them, where
+ * the ring wraps); shm_consume() them once they are copied or parsed */
+size_t shm_peek(ShmLink *l, const char **p);
+void shm_consume(ShmLink *l, size_t n);
+/* Nothing left to read: ask to be rung for more. 0 if more arrived in the
+ * meantime (read again), 1 if it is safe to wait on the doorbell. */
+int shm_idle(ShmLink *l);
+
+#endif /* SHM_H */
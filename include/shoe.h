@@ -0,0 +1,99 @@
+#ifndef SHOE_H
+#define SHOE_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "deck.h"
+#include "rng.h"
+
+#define SHOE_MAX_DECKS 8
+#define SHOE_MAX_CARDS (SHOE_MAX_DECKS * DECK_SIZE)
+
+#define SHOE_DEFAULT_DECKS 6
+#define SHOE_DEFAULT_PENETRATION 0.75
+
+/* Where a pooled shoe's spare buffer is in its life */
+typedef enum {
+    SPARE_QUEUED,             /* waiting for a shuffler thread */
+    SPARE_SHUFFLING,          /* being shuffled, by a shuffler or the owner */
+    SPARE_READY               /* shuffled; the next shoe_shuffle() swaps it in */
+} SpareState;
+
+struct ShoePool;
+
+/*
+ * A dealing shoe of one or more decks. It lives as long as its table: the
+ * cut card sits at `penetration` of the way in, and the shoe is only
+ * reshuffled at the start of the first round after the cut card came out.
+ *
+ * The shoe owns two card buffers. Attached to a ShoePool, the one not being
+ * dealt is shuffled by a background thread, so a reshuffle on the deal path
+ * is a pointer swap. The spare is always a copy of the shoe before it,
+ * shuffled with the shoe's own Rng one shoe at a time, so a seed deals the
+ * same sequence of shoes pooled or not.
+ */
+typedef struct Shoe {
+    Card bufs[2][SHOE_MAX_CARDS];
+    Card *cards;              /* the buffer being dealt */
+    Card *spare;              /* the next shoe; pooled shoes shuffle it ahead */
+    int ndecks;
+    int size;                 /* ndecks * DECK_SIZE */
+    int top;                  /* index of next card to deal */
+    int cut;                  /* cut card position; reaching it ends the shoe */
+    unsigned long shuffles;   /* shuffles since the last seed */
+    Rng rng;                  /* private stream, so shuffles are reproducible and thread-safe */
+
+    struct ShoePool *pool;    /* NULL: shuffle inline */
+    int spare_state;          /* SpareState, only meaningful when pooled */
+    struct Shoe *next_job;    /* pool queue link */
+} Shoe;
+
+/* Build and shuffle an ndecks shoe, seeded from the clock; -1 on bad
+ * arguments (ndecks outside 1..SHOE_MAX_DECKS, penetration outside (0, 1]) */
+int shoe_init(Shoe *shoe, int ndecks, double penetration);
+/* shoe_init() then shoe_seed(), without the clock-seeded shuffle between */
+int shoe_init_seeded(Shoe *shoe, int ndecks, double penetration, uint64_t seed);
+/* Pin the shoe to a known stream, then reshuffle. Call before pooling. */
+void shoe_seed(Shoe *shoe, uint64_t seed);
+void shoe_set_rng(Shoe *shoe, const Rng *rng);
+
+/* Start a fresh shoe: swaps in the spare if pooled, else shuffles in place */
+void shoe_shuffle(Shoe *shoe);
+/* Call between rounds: shuffles if the cut card has come out; 1 if it did */
+int shoe_begin_round(Shoe *shoe);
+/* Next card. Running out mid-round (a tiny shoe cut very deep) starts a
+ * fresh shoe rather than failing. */
+Card shoe_deal(Shoe *shoe);
+int shoe_remaining(const Shoe *shoe);
+
+/* ---------- background shuffling ---------- */
+
+typedef struct {
+    unsigned long long shuffled;  /* spares shuffled by pool threads */
+    unsigned long long swaps;     /* reshuffles served by a ready spare */
+    unsigned long long dry;       /* reshuffles that found no ready spare */
+} ShoePoolStats;
+
+/*
+ * Shuffler threads fed by a FIFO of shoes whose spare needs shuffling.
+ * Shoes must outlive the pool once attached (tables are never freed).
+ */
+typedef struct ShoePool {
+    pthread_mutex_t lock;
+    pthread_cond_t work;      /* a spare was queued */
+    pthread_cond_t done;      /* a spare became ready */
+    Shoe *head;
+    Shoe *tail;
+    pthread_t *threads;
+    int nthreads;
+    ShoePoolStats stats;      /* updated atomically */
+} ShoePool;
+
+/* Start nthreads shuffler threads; 0 ok, -1 on failure */
+int shoe_pool_init(ShoePool *pool, int nthreads);
+/* Hand the shoe's spare to the pool; from now on shoe_shuffle() swaps */
+void shoe_attach_pool(Shoe *shoe, ShoePool *pool);
+void shoe_pool_stats(ShoePool *pool, ShoePoolStats *out);
+
+#endif /* SHOE_H */
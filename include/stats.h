@@ -0,0 +1,88 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Server instrumentation. Every shard thread owns one ServerStats block and
+ * is its only writer, so counting is a plain load and store with no locked
+ * instruction; readers sum all the blocks (relaxed loads) only when someone
+ * asks. Threads without a block (the accept thread, tools linking conn.c)
+ * count nothing.
+ */
+
+typedef enum {
+    STAT_ROUNDS,
+    STAT_DECISIONS,           /* HIT and STAND */
+    STAT_HINTS,
+    STAT_TIMEOUTS,            /* turns stood for by the deadline */
+    STAT_CONNECTS,
+    STAT_CLOSES,
+    STAT_MID_TURN,            /* disconnects while deciding */
+    STAT_BYTES_OUT,
+    STAT_BYTES_IN,
+    STAT_SENDS,               /* send() calls */
+    STAT_RECVS,               /* recv() calls */
+    STAT_POLLS,               /* epoll_wait() or io_uring_enter() waits */
+    STAT_RING_SQES,           /* io_uring requests submitted */
+    STAT_RX_NOBUFS,           /* io_uring receives that found no buffer */
+    STAT_TX_BACKLOG,          /* bytes waiting for slow readers, now */
+    STAT_TX_STALLS,           /* times a socket stopped taking output */
+    STAT_SAT_OUT,             /* rounds a congested player was left out of */
+    STAT_EVICTIONS,           /* slow readers dropped */
+    STAT_JOURNAL_WAITS,       /* rounds that waited for the journal writer */
+    STAT_COUNTERS
+} StatCounter;
+
+typedef enum {
+    PHASE_DEAL,               /* shoe turnover, initial deal, encoding */
+    PHASE_THINK,              /* prompt sent to decision read, per decision */
+    PHASE_DECISION,           /* applying one decision */
+    PHASE_DEALER,             /* dealer draws */
+    PHASE_RESULTS,            /* results encoded and flushed to every seat */
+    PHASE_STALL,              /* a backlog, from its first byte to drained */
+    PHASE_COUNT
+} StatPhase;
+
+/* Log-linear buckets: four per power of two, ~25% wide, up to ~37 minutes */
+#define STAT_BUCKETS 160
+
+typedef struct ServerStats {
+    uint64_t counters[STAT_COUNTERS];
+    uint64_t hist[PHASE_COUNT][STAT_BUCKETS];   /* ns */
+    struct ServerStats *next;                   /* every registered block */
+} ServerStats;
+
+/* The calling thread's block, NULL if it has none */
+extern __thread ServerStats *stats_local;
+
+/* Add a block to the ones stats_format() sums; call before its thread starts */
+void stats_register(ServerStats *s);
+
+static inline void stats_count(StatCounter c, uint64_t n) {
+    ServerStats *s = stats_local;
+    if (s) {
+        uint64_t v = __atomic_load_n(&s->counters[c], __ATOMIC_RELAXED);
+        __atomic_store_n(&s->counters[c], v + n, __ATOMIC_RELAXED);
+    }
+}
+
+/* For counters that are levels (STAT_TX_BACKLOG): take some back off */
+static inline void stats_uncount(StatCounter c, uint64_t n) {
+    stats_count(c, (uint64_t)0 - n);
+}
+
+/* Start of a timed phase: the clock in ns, or 0 on a thread without stats */
+uint64_t stats_clock(void);
+/* Record now - start into the phase's histogram; a 0 start is ignored */
+void stats_phase(StatPhase p, uint64_t start);
+
+/* Sum every block into a text report; returns its length, truncated to room */
+size_t stats_format(char *buf, size_t room);
+
+/* Serve stats_format() to each connection on a Unix socket at path, from a
+ * thread of its own. 0 ok, -1 on failure. */
+int stats_serve(const char *path);
+
+#endif /* STATS_H */
@@ -0,0 +1,35 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include "blackjack.h"
+#include "deck.h"
+
+/*
+ * Hit/stand advice and the dealer's final-total odds for this table's rules
+ * (dealer hits below 17 and stands on soft 17, no doubling or splitting).
+ * Both come from tables gen_tables writes at build time, assuming an
+ * infinite shoe, so every lookup is a couple of array reads.
+ */
+
+/* How play_dealer_hand() can end */
+typedef enum {
+    DEALER_17,
+    DEALER_18,
+    DEALER_19,
+    DEALER_20,
+    DEALER_21,
+    DEALER_BUST,
+    DEALER_OUTCOMES
+} DealerOutcome;
+
+typedef enum {
+    HINT_STAND = 0,
+    HINT_HIT   = 1
+} Hint;
+
+/* Best move for the player's hand against the dealer's up card */
+Hint strategy_hint(const Hand *player, Card up);
+/* Probability of each DealerOutcome given the up card; DEALER_OUTCOMES long */
+const double *strategy_dealer_odds(Card up);
+
+#endif /* STRATEGY_H */
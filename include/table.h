@@ -0,0 +1,88 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "blackjack.h"
+#include "broadcast.h"
+#include "conn.h"
+#include "journal.h"
+#include "shoe.h"
+#include "timerwheel.h"
+
+#define MAX_PLAYERS 5
+#define ALL_SEATS   ((1u << MAX_PLAYERS) - 1)
+
+/* Shoe shape for every table; set from the command line before shards start */
+extern int table_decks;
+extern double table_penetration;
+/* Shuffles tables' next shoes in the background; NULL shuffles inline */
+extern ShoePool *table_shoe_pool;
+/* Deadlines, in ms (0 = none): a decision, and the pause before each round */
+extern int table_turn_timeout_ms;
+extern int table_lobby_wait_ms;
+/* Missed decisions in a row before a player is dropped (0 = never) */
+extern int table_idle_turns;
+/* Every finished round is recorded here; NULL keeps no record */
+extern Journal *table_journal;
+
+typedef enum {
+    TABLE_IDLE,               /* between rounds */
+    TABLE_DEALING,            /* shuffle if the cut card is out, initial two cards */
+    TABLE_AWAITING_DECISION,  /* walking the seats, one player at a time */
+    TABLE_DEALER_PLAY,        /* dealer hits until 17 */
+    TABLE_RESULTS             /* results fan-out, then back to idle */
+} TableState;
+
+typedef struct Table {
+    int id;
+    PlayerConn *seats[MAX_PLAYERS];
+    unsigned seated;          /* bit i set while seats[i] is taken */
+    Hand dealer;
+    Shoe shoe;                /* kept across rounds, reshuffled at the cut card */
+    uint64_t seed;            /* the shoe's seed, enough to replay its shuffles */
+    TableState state;
+    int turn;                 /* seat currently acting, -1 before the first */
+    uint32_t rounds;          /* dealt so far */
+    JournalRound journal;     /* the round being played, when journaling */
+
+    int queued;               /* 1 while on the owning shard's run queue */
+    struct Table *next_run;
+
+    TimerWheel *timers;       /* the owning shard's; NULL runs without deadlines */
+    Timer lobby;              /* armed while waiting to deal the next round */
+
+    struct Lobby *index;      /* the owner's lobby; NULL if none files it */
+    struct Table *next_open;  /* in the lobby bucket for its seated count */
+    struct Table **pprev_open;    /* NULL while full or unfiled */
+
+    PlayerConn *spectators;   /* watching, not seated */
+    Feed *feed;               /* this phase's public events; NULL while unwatched */
+} Table;
+
+/* The table's shoe gets its own stream, seeded from the owner's PRNG */
+void table_init(Table *t, int id, uint64_t seed);
+int table_count_active(const Table *t);
+
+/* Seat a connection in the first free seat; returns the seat index or -1 */
+int table_seat_player(Table *t, PlayerConn *pc);
+/* Drop a player (disconnect); hands the turn on if they were acting */
+void table_remove_player(Table *t, PlayerConn *pc);
+/* The acting player's deadline passed: stand for them. Call table_advance()
+ * afterwards to move the turn on. */
+void table_expire_turn(Table *t, PlayerConn *pc);
+
+/* A seated player asked to WATCH: give up the seat and follow the table's
+ * public events from the next phase on. 0 ok, -1 out of memory (the player
+ * keeps their seat). */
+int table_watch(Table *t, PlayerConn *pc);
+/* A spectator left or is being dropped */
+void table_remove_spectator(Table *t, PlayerConn *pc);
+
+/*
+ * Run the table's state machine until it has to wait for a player's
+ * decision, then flush every seat's queued output and hand the phase's
+ * public events to the spectators. Returns 1 when a round just finished and players remain,
+ * i.e. the caller should schedule the next round.
+ */
+int table_advance(Table *t);
+
+#endif /* TABLE_H */
@@ -0,0 +1,55 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hierarchical timing wheel with 1 ms ticks: four levels of 256 slots
+ * cover 2^32 ms (~49 days); anything further out is clamped to that.
+ * Arming and cancelling are O(1); each tick pops one level-0 slot, and every
+ * 256th tick also cascades one slot of the level above down a level.
+ *
+ * Timers are embedded in their owners (no allocation), and a wheel belongs
+ * to one thread: arm, cancel and run must all be called from it.
+ */
+
+#define TW_LEVELS 4
+#define TW_BITS   8
+#define TW_SLOTS  (1 << TW_BITS)
+
+struct Timer;
+typedef void (*TimerFn)(struct Timer *t, void *ctx);
+
+typedef struct Timer {
+    uint64_t expires;         /* ms on the timer_now_ms() clock */
+    struct Timer *next;
+    struct Timer **pprev;     /* NULL while not armed */
+    TimerFn fn;
+} Timer;
+
+typedef struct TimerWheel {
+    Timer *slots[TW_LEVELS][TW_SLOTS];
+    uint64_t current;         /* next tick to run */
+    size_t count;             /* armed timers */
+} TimerWheel;
+
+/* Milliseconds from CLOCK_MONOTONIC */
+uint64_t timer_now_ms(void);
+
+void timer_wheel_init(TimerWheel *w, uint64_t now);
+void timer_init(Timer *t, TimerFn fn);
+static inline int timer_armed(const Timer *t) { return t->pprev != NULL; }
+
+/* (Re)arm to fire at `expires`; a time already past fires on the next run */
+void timer_arm(TimerWheel *w, Timer *t, uint64_t expires);
+void timer_cancel(TimerWheel *w, Timer *t);
+
+/* Fire everything due by `now`, passing ctx to each callback. Callbacks may
+ * arm or cancel any timer. Returns the number fired. */
+int timer_wheel_run(TimerWheel *w, uint64_t now, void *ctx);
+/* Milliseconds a poll may sleep before the wheel needs running again, -1
+ * if nothing is armed. Exact for timers due within the next 256 ms. */
+int timer_wheel_timeout(const TimerWheel *w, uint64_t now);
+
+#endif /* TIMERWHEEL_H */
@@ -0,0 +1,137 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+/*
+ * Just enough io_uring for the server, on the raw system calls. Requests
+ * are prepared into the submission queue and go to the kernel together at
+ * the next uring_wait(), which also collects completions: one system call
+ * per loop for every send, receive and accept in the batch.
+ *
+ * A ring can carry a set of provided receive buffers, registered with the
+ * kernel, from which a multishot recv picks one per completion; give each
+ * back with uring_buf_return() once its bytes are copied out.
+ *
+ * uring_init() fails (-1, errno set) where io_uring or the features used
+ * here are missing or forbidden, multishot recv on a ring with buffers
+ * included; callers fall back to epoll. A ring belongs
+ * to the thread that created it.
+ */
+
+#define URING_BGID 0         /* the provided-buffer group */
+
+typedef struct Uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local;        /* our tail, ahead of *sq_tail until submitted */
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    struct io_uring_buf_ring *br;   /* provided receive buffers, if any */
+    size_t br_size;
+    char *buf_base;
+    unsigned buf_count;       /* a power of two */
+    unsigned buf_size;
+    unsigned short buf_tail;
+} Uring;
+
+/* entries and nbufs are powers of two; nbufs 0 for a ring without buffers */
+int uring_init(Uring *u, unsigned entries, unsigned nbufs, unsigned buf_size);
+void uring_close(Uring *u);
+
+/* A zeroed request slot; a full queue is submitted first to make room.
+ * NULL only if that submit failed. */
+struct io_uring_sqe *uring_sqe(Uring *u);
+/* Submit what is queued, then wait up to timeout_ms (-1 forever, 0 not at
+ * all) for a completion. 0 ok (timeouts included), -1 on failure. */
+int uring_wait(Uring *u, int timeout_ms);
+
+/* Next completion, or NULL; call uring_seen() once it is handled */
+static inline struct io_uring_cqe *uring_peek(Uring *u) {
+    unsigned head = *u->cq_head;
+    if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &u->cqes[head & u->cq_mask];
+}
+
+static inline void uring_seen(Uring *u) {
+    __atomic_store_n(u->cq_head, *u->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+static inline char *uring_buf(Uring *u, unsigned id) {
+    return u->buf_base + (size_t)id * u->buf_size;
+}
+void uring_buf_return(Uring *u, unsigned id);
+
+/* ---------- requests ---------- */
+
+static inline void uring_prep(struct io_uring_sqe *sqe, int op, int fd,
+                              const void *addr, unsigned len, uint64_t user_data) {
+    sqe->opcode = (uint8_t)op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+}
+
+/* One receive of at most len bytes into a provided buffer */
+static inline void uring_prep_recv_select(struct io_uring_sqe *sqe, int fd, unsigned len,
+                                          uint64_t user_data) {
+    uring_prep(sqe, IORING_OP_RECV, fd, NULL, len, user_data);
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+}
+
+/* One completion per arrival, each in a provided buffer, until it fails */
+static inline void uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+    uring_prep_recv_select(sqe, fd, 0, user_data);
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+}
+
+static inline void uring_prep_send(struct io_uring_sqe *sqe, int fd, const void *buf,
+                                   size_t len, uint64_t user_data) {
+    uring_prep(sqe, IORING_OP_SEND, fd, buf, (unsigned)len, user_data);
+    sqe->msg_flags = MSG_NOSIGNAL;
+}
+
+static inline void uring_prep_read(struct io_uring_sqe *sqe, int fd, void *buf,
+                                   unsigned len, uint64_t user_data) {
+    uring_prep(sqe, IORING_OP_READ, fd, buf, len, user_data);
+}
+
+/* One completion per readiness event until cancelled */
+static inline void uring_prep_poll_multishot(struct io_uring_sqe *sqe, int fd,
+                                             unsigned events, uint64_t user_data) {
+    uring_prep(sqe, IORING_OP_POLL_ADD, fd, NULL, IORING_POLL_ADD_MULTI, user_data);
+    sqe->poll32_events = events;
+}
+
+/* One completion, carrying the new socket, per accepted connection */
+static inline void uring_prep_accept_multishot(struct io_uring_sqe *sqe, int fd, uint64_t user_data) {
+    uring_prep(sqe, IORING_OP_ACCEPT, fd, NULL, 0, user_data);
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+}
+
+/* Ends the request posted with target's user_data; it completes -ECANCELED */
+static inline void uring_prep_cancel(struct io_uring_sqe *sqe, uint64_t target, uint64_t user_data) {
+    uring_prep(sqe, IORING_OP_ASYNC_CANCEL, -1, NULL, 0, user_data);
+    sqe->addr = target;
+}
+
+#endif /* URING_H */
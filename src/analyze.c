@@ -0,0 +1,197 @@
+/*
+ * Exact EV analysis
+ * Solves hit/stand for every starting deal from a given shoe composition
+ * with the recursion in ev.c, instead of sampling it like ./simulate.
+ *
+ * Usage: ./analyze [--decks D] [--threads T] [--remove CARDS]
+ *                  [--hand CARDS --up CARD]
+ *
+ * --remove takes cards already seen out of the shoe ("5 5 6 A"; suits are
+ * optional). --hand/--up solves one position and prints the dealer's odds;
+ * otherwise the whole round is solved and printed as a hit/stand chart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/ev.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--decks 1-%d] [--threads T] [--remove CARDS]\n"
+            "          [--hand CARDS --up CARD]\n", prog, EV_MAX_DECKS);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* "A", "10", "K", "7H": a rank with an optional suit; 0 if unrecognised */
+static Card parse_rank(const char *s, size_t len) {
+    if (len && strchr("CDHS", s[len - 1]) && len > 1) len--;
+    int rank;
+    if (len == 2 && s[0] == '1' && s[1] == '0') rank = 10;
+    else if (len != 1) return 0;
+    else if (s[0] == 'A') rank = 1;
+    else if (s[0] == 'T' || s[0] == 'J') rank = 11;
+    else if (s[0] == 'Q') rank = 12;
+    else if (s[0] == 'K') rank = 13;
+    else if (s[0] >= '2' && s[0] <= '9') rank = s[0] - '0';
+    else return 0;
+    return card_make(rank, 0);
+}
+
+/* Space-separated cards into out[]; the count, or -1 on a bad card */
+static int parse_cards(const char *s, Card *out, int max) {
+    int n = 0;
+    while (*s) {
+        while (*s == ' ' || *s == ',') s++;
+        size_t len = strcspn(s, " ,");
+        if (len == 0) break;
+        if (n == max) return -1;
+        Card c = parse_rank(s, len);
+        if (!c) return -1;
+        out[n++] = c;
+        s += len;
+    }
+    return n;
+}
+
+static const char *rank_label(int r) {
+    static const char *labels[] = { "?", "A", "2", "3", "4", "5", "6", "7", "8", "9", "T" };
+    return labels[r];
+}
+
+static int solve_one(const EvComp *comp, const Card *hand, int nhand, Card up) {
+    EvComp c = *comp;
+    Hand h;
+    hand_init(&h);
+    for (int i = 0; i < nhand; i++) {
+        hand_add_card(&h, hand[i]);
+        if (ev_comp_remove(&c, hand[i]) < 0) {
+            fprintf(stderr, "not enough cards left for that hand\n");
+            return 1;
+        }
+    }
+    if (ev_comp_remove(&c, up) < 0) {
+        fprintf(stderr, "not enough cards left for that up card\n");
+        return 1;
+    }
+
+    EvCtx ctx;
+    if (ev_init(&ctx) < 0) {
+        perror("ev_init");
+        return 1;
+    }
+    double odds[DEALER_OUTCOMES];
+    EvResult r;
+    ev_dealer_odds(&ctx, &c, up, odds);
+    int can_hit = ev_hand(&ctx, &c, &h, up, &r);
+    ev_free(&ctx);
+
+    char buf[64];
+    hand_to_string(&h, buf, sizeof(buf));
+    printf("hand          %s (%s %d)\n", buf, hand_is_soft(&h) ? "soft" : "hard", hand_value(&h));
+    printf("dealer odds   17 %.5f  18 %.5f  19 %.5f  20 %.5f  21 %.5f  bust %.5f\n",
+           odds[DEALER_17], odds[DEALER_18], odds[DEALER_19],
+           odds[DEALER_20], odds[DEALER_21], odds[DEALER_BUST]);
+    printf("stand         %+.6f\n", r.stand);
+    if (can_hit) printf("hit           %+.6f\n", r.hit);
+    printf("best          %s\n", can_hit && r.hit > r.stand ? "HIT" : "STAND");
+    return 0;
+}
+
+static int solve_round(const EvComp *comp, int nthreads) {
+    static EvAnalysis a;
+    double t0 = now_sec();
+    if (ev_analyze(comp, nthreads, &a) < 0) {
+        fprintf(stderr, "analysis failed\n");
+        return 1;
+    }
+    double elapsed = now_sec() - t0;
+
+    // H/S chart, one row per starting pair, one column per up card
+    printf("hand ");
+    for (int up = 2; up <= EV_RANKS + 1; up++) printf(" %s", rank_label(up > EV_RANKS ? 1 : up));
+    printf("\n");
+    for (int a1 = 1; a1 <= EV_RANKS; a1++) {
+        for (int b1 = a1; b1 <= EV_RANKS; b1++) {
+            printf("%s,%s  ", rank_label(a1), rank_label(b1));
+            for (int col = 2; col <= EV_RANKS + 1; col++) {
+                int up = col > EV_RANKS ? 1 : col;
+                char mark = '.';
+                for (int i = 0; i < a.ndeals; i++) {
+                    const EvDeal *d = &a.deals[i];
+                    if (d->a == a1 && d->b == b1 && d->up == up)
+                        mark = d->ev.hit > d->ev.stand ? 'H' : 'S';
+                }
+                printf(" %c", mark);
+            }
+            printf("\n");
+        }
+    }
+
+    printf("\ndeals         %d\n", a.ndeals);
+    printf("EV per round  %+.6f\n", a.ev);
+    printf("threads       %d\n", nthreads);
+    printf("elapsed       %.3f s\n", elapsed);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int decks = 1;
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *remove = NULL, *hand = NULL, *up = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--decks") == 0 && i + 1 < argc) {
+            decks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nthreads = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--remove") == 0 && i + 1 < argc) {
+            remove = argv[++i];
+        } else if (strcmp(argv[i], "--hand") == 0 && i + 1 < argc) {
+            hand = argv[++i];
+        } else if (strcmp(argv[i], "--up") == 0 && i + 1 < argc) {
+            up = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (decks < 1 || decks > EV_MAX_DECKS || (!hand != !up)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (nthreads < 1) nthreads = 1;
+
+    EvComp comp;
+    ev_comp_decks(&comp, decks);
+    if (remove) {
+        Card seen[EV_MAX_DECKS * DECK_SIZE];
+        int n = parse_cards(remove, seen, EV_MAX_DECKS * DECK_SIZE);
+        for (int i = 0; i < n; i++) {
+            if (ev_comp_remove(&comp, seen[i]) < 0) n = -1;
+        }
+        if (n < 0) {
+            fprintf(stderr, "bad --remove list\n");
+            return 1;
+        }
+    }
+
+    if (hand) {
+        Card cards[MAX_HAND_CARDS], upc[1];
+        int n = parse_cards(hand, cards, MAX_HAND_CARDS);
+        if (n < 1 || parse_cards(up, upc, 1) != 1) {
+            usage(argv[0]);
+            return 1;
+        }
+        return solve_one(&comp, cards, n, upc[0]);
+    }
+    return solve_round(&comp, (int)nthreads);
+}
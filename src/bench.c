@@ -0,0 +1,324 @@
+/*
+ * Engine microbenchmarks
+ * Times the hot-path primitives one at a time so a change that slows any of
+ * them shows up as a ns/op regression.
+ *
+ * Usage: ./bench [--format text|json|csv] [--samples N] [--filter SUBSTR]
+ *                [--seed S]
+ *
+ * Each benchmark is warmed up, then its batch size is doubled until one
+ * batch takes at least BENCH_MIN_SAMPLE_NS (or hits its cap), so clock
+ * overhead stays in the noise. Every sample times one batch; the report gives percentiles of
+ * ns/op over the samples. The same --seed gives the same shuffles and hands.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../include/blackjack.h"
+#include "../include/conn.h"
+#include "../include/proto.h"
+#include "../include/shoe.h"
+
+#define BENCH_WARMUP_NS     50000000L   /* 50 ms of untimed runs first */
+#define BENCH_MIN_SAMPLE_NS 200000L     /* 0.2 ms per timed batch at least */
+#define BENCH_HANDS         1024
+#define SEND_MAX_BATCH      128         /* unix sockets budget per send, not per byte */
+
+typedef enum { FMT_TEXT, FMT_JSON, FMT_CSV } Format;
+
+/* ---------- fixtures ---------- */
+
+static struct {
+    Shoe shoe6;
+    Shoe shoe1;
+    Hand hands[BENCH_HANDS];
+    int sock[2];              /* conn writes to [0], the harness drains [1] */
+    PlayerConn *conn;
+    char buf[256];
+} fx;
+
+/* Results are folded into this so the compiler can't drop the work */
+static volatile unsigned long sink;
+
+static void fixtures_init(uint64_t seed) {
+    shoe_init(&fx.shoe6, 6, 1.0);
+    shoe_seed(&fx.shoe6, seed);
+    shoe_init(&fx.shoe1, 1, 1.0);
+    shoe_seed(&fx.shoe1, seed + 1);
+
+    // 2 to 5 cards each, the spread a table actually sees
+    Shoe deal;
+    shoe_init(&deal, 6, 1.0);
+    shoe_seed(&deal, seed + 2);
+    for (int i = 0; i < BENCH_HANDS; i++) {
+        hand_init(&fx.hands[i]);
+        int n = 2 + (int)rng_bounded(&deal.rng, 4);
+        for (int k = 0; k < n; k++) hand_add_card(&fx.hands[i], shoe_deal(&deal));
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fx.sock) < 0) {
+        perror("socketpair");
+        fx.sock[0] = fx.sock[1] = -1;
+        return;
+    }
+    fx.conn = conn_new();
+    if (fx.conn) fx.conn->socket_fd = fx.sock[0];
+}
+
+/* ---------- benchmarks ---------- */
+
+static void b_shuffle6(long n) {
+    for (long i = 0; i < n; i++) shoe_shuffle(&fx.shoe6);
+    sink += fx.shoe6.cards[0];
+}
+
+static void b_shuffle1(long n) {
+    for (long i = 0; i < n; i++) shoe_shuffle(&fx.shoe1);
+    sink += fx.shoe1.cards[0];
+}
+
+/* Rewinds instead of reshuffling at the end, so only dealing is timed */
+static void b_deal(long n) {
+    unsigned long acc = 0;
+    for (long i = 0; i < n; i++) {
+        if (fx.shoe6.top >= fx.shoe6.size) fx.shoe6.top = 0;
+        acc += shoe_deal(&fx.shoe6);
+    }
+    sink += acc;
+}
+
+static void b_hand_add(long n) {
+    unsigned long acc = 0;
+    Hand h;
+    for (long i = 0; i < n; i++) {
+        if ((i & 3) == 0) hand_init(&h);
+        hand_add_card(&h, fx.hands[i & (BENCH_HANDS - 1)].cards[0]);
+        acc += h.hard;
+    }
+    sink += acc;
+}
+
+static void b_hand_value(long n) {
+    unsigned long acc = 0;
+    for (long i = 0; i < n; i++) acc += (unsigned long)hand_value(&fx.hands[i & (BENCH_HANDS - 1)]);
+    sink += acc;
+}
+
+static void b_hand_flags(long n) {
+    unsigned long acc = 0;
+    for (long i = 0; i < n; i++) {
+        const Hand *h = &fx.hands[i & (BENCH_HANDS - 1)];
+        acc += (unsigned long)(hand_is_bust(h) + hand_is_blackjack(h) + hand_is_soft(h));
+    }
+    sink += acc;
+}
+
+static void b_hand_to_string(long n) {
+    for (long i = 0; i < n; i++) hand_to_string(&fx.hands[i & (BENCH_HANDS - 1)], fx.buf, sizeof(fx.buf));
+    sink += (unsigned char)fx.buf[0];
+}
+
+static void b_card_to_string(long n) {
+    for (long i = 0; i < n; i++)
+        card_to_string(fx.hands[i & (BENCH_HANDS - 1)].cards[0], fx.buf, sizeof(fx.buf));
+    sink += (unsigned char)fx.buf[0];
+}
+
+static void b_put_hand_text(long n) {
+    size_t acc = 0;
+    for (long i = 0; i < n; i++)
+        acc += proto_put_hand(fx.buf, sizeof(fx.buf), 0, OP_YOUR_HAND, &fx.hands[i & (BENCH_HANDS - 1)]);
+    sink += acc;
+}
+
+static void b_put_hand_binary(long n) {
+    size_t acc = 0;
+    for (long i = 0; i < n; i++)
+        acc += proto_put_hand(fx.buf, sizeof(fx.buf), 1, OP_YOUR_HAND, &fx.hands[i & (BENCH_HANDS - 1)]);
+    sink += acc;
+}
+
+/* One queued message, then the phase's single send() into a local socket */
+static void b_conn_flush(long n) {
+    for (long i = 0; i < n; i++) {
+        conn_send_int(fx.conn, OP_PLAYER_VALUE, (int)(i & 31));
+        conn_flush(fx.conn);
+    }
+}
+
+static void drain_sock(void) {
+    char tmp[65536];
+    while (recv(fx.sock[1], tmp, sizeof(tmp), MSG_DONTWAIT) > 0) {}
+}
+
+typedef struct {
+    const char *name;
+    void (*fn)(long n);
+    void (*after)(void);      /* untimed, after every batch */
+    long max_batch;           /* 0 = no limit */
+} Bench;
+
+static const Bench benches[] = {
+    { "shoe_shuffle/6deck",     b_shuffle6,        NULL,       0 },
+    { "shoe_shuffle/1deck",     b_shuffle1,        NULL,       0 },
+    { "shoe_deal",              b_deal,            NULL,       0 },
+    { "hand_add_card",          b_hand_add,        NULL,       0 },
+    { "hand_value",             b_hand_value,      NULL,       0 },
+    { "hand_is_bust+bj+soft",   b_hand_flags,      NULL,       0 },
+    { "hand_to_string",         b_hand_to_string,  NULL,       0 },
+    { "card_to_string",         b_card_to_string,  NULL,       0 },
+    { "proto_put_hand/text",    b_put_hand_text,   NULL,       0 },
+    { "proto_put_hand/binary",  b_put_hand_binary, NULL,       0 },
+    { "conn_flush",             b_conn_flush,      drain_sock, SEND_MAX_BATCH },
+};
+
+/* ---------- harness ---------- */
+
+typedef struct {
+    const char *name;
+    long batch;
+    int samples;
+    double min, p50, p90, p99, max, mean;
+} Result;
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static long time_batch(const Bench *b, long n) {
+    long t0 = now_ns();
+    b->fn(n);
+    long t = now_ns() - t0;
+    if (b->after) b->after();
+    return t;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted v[0..n) */
+static double percentile(const double *v, int n, double p) {
+    int k = (int)(p / 100.0 * n + 0.5);
+    if (k < 1) k = 1;
+    if (k > n) k = n;
+    return v[k - 1];
+}
+
+static int run(const Bench *b, int samples, Result *r) {
+    long batch = 1;
+    for (long end = now_ns() + BENCH_WARMUP_NS; now_ns() < end;) time_batch(b, batch);
+    while (time_batch(b, batch) < BENCH_MIN_SAMPLE_NS && (!b->max_batch || batch < b->max_batch))
+        batch *= 2;
+
+    double *ns = malloc((size_t)samples * sizeof(*ns));
+    if (!ns) {
+        perror("malloc");
+        return -1;
+    }
+    double sum = 0.0;
+    for (int i = 0; i < samples; i++) {
+        ns[i] = (double)time_batch(b, batch) / (double)batch;
+        sum += ns[i];
+    }
+    qsort(ns, (size_t)samples, sizeof(*ns), cmp_double);
+
+    r->name = b->name;
+    r->batch = batch;
+    r->samples = samples;
+    r->min = ns[0];
+    r->p50 = percentile(ns, samples, 50);
+    r->p90 = percentile(ns, samples, 90);
+    r->p99 = percentile(ns, samples, 99);
+    r->max = ns[samples - 1];
+    r->mean = sum / samples;
+    free(ns);
+    return 0;
+}
+
+static void report(Format fmt, const Result *r, int first) {
+    switch (fmt) {
+    case FMT_TEXT:
+        if (first)
+            printf("%-24s %10s %10s %10s %10s %10s  (ns/op)\n", "benchmark", "min", "p50", "p90", "p99", "max");
+        printf("%-24s %10.2f %10.2f %10.2f %10.2f %10.2f\n", r->name, r->min, r->p50, r->p90, r->p99, r->max);
+        break;
+    case FMT_CSV:
+        if (first) printf("name,batch,samples,min_ns,p50_ns,p90_ns,p99_ns,max_ns,mean_ns\n");
+        printf("%s,%ld,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", r->name, r->batch, r->samples,
+               r->min, r->p50, r->p90, r->p99, r->max, r->mean);
+        break;
+    case FMT_JSON:
+        printf("%s    {\"name\": \"%s\", \"batch\": %ld, \"samples\": %d, \"ns_per_op\": "
+               "{\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"mean\": %.3f}}",
+               first ? "" : ",\n", r->name, r->batch, r->samples,
+               r->min, r->p50, r->p90, r->p99, r->max, r->mean);
+        break;
+    }
+    fflush(stdout);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--format text|json|csv] [--samples N] [--filter SUBSTR]\n"
+            "          [--seed S]\n"
+            "benchmarks:", prog);
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+        fprintf(stderr, " %s", benches[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[]) {
+    Format fmt = FMT_TEXT;
+    int samples = 200;
+    const char *filter = NULL;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *f = argv[++i];
+            if (strcmp(f, "text") == 0) fmt = FMT_TEXT;
+            else if (strcmp(f, "json") == 0) fmt = FMT_JSON;
+            else if (strcmp(f, "csv") == 0) fmt = FMT_CSV;
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (samples < 1) samples = 1;
+
+    fixtures_init(seed);
+
+    if (fmt == FMT_JSON)
+        printf("{\n  \"seed\": %llu,\n  \"benchmarks\": [\n", (unsigned long long)seed);
+    int first = 1;
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        const Bench *b = &benches[i];
+        if (filter && !strstr(b->name, filter)) continue;
+        if (b->fn == b_conn_flush && !fx.conn) continue;
+        Result r;
+        if (run(b, samples, &r) < 0) return 1;
+        report(fmt, &r, first);
+        first = 0;
+    }
+    if (fmt == FMT_JSON) printf("\n  ]\n}\n");
+    return 0;
+}
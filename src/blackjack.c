@@ -1,9 +1,14 @@
 #include "../include/blackjack.h"
 #include <string.h>
 
+/* points per rank, aces as 1; indexed by card_rank() */
+static const uint8_t rank_points[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 10, 10 };
+
 void hand_init(Hand *hand) 
 {
     hand->count = 0;
+    hand->hard = 0;
+    hand->aces = 0;
 }
 
 void hand_add_card(Hand *hand, Card card) 
@@ -11,28 +16,14 @@ void hand_add_card(Hand *hand, Card card)
     if (hand->count < MAX_HAND_CARDS) 
     {
         hand->cards[hand->count++] = card;
+        hand->hard += rank_points[card_rank(card)];
+        hand->aces += card_rank(card) == 1;
     }
 }
 
+/* at most one ace can count as 11 without busting */
 int hand_value(const Hand *hand) {
-    int total = 0;
-    int aces = 0;
-    for (int i = 0; i < hand->count; i++) {
-        int r = hand->cards[i].rank;
-        if (r == 1) {
-            aces++;
-            total += 11;
-        } else if (r >= 11 && r <= 13) {
-            total += 10;
-        } else {
-            total += r;
-        }
-    }
-    while (total > 21 && aces > 0) {
-        total -= 10; /* downgrade an ace from 11 to 1 */
-        aces--;
-    }
-    return total;
+    return hand_is_soft(hand) ? hand->hard + 10 : hand->hard;
 }
 
 int hand_is_blackjack(const Hand *hand) {
@@ -43,12 +34,37 @@ int hand_is_bust(const Hand *hand) {
     return hand_value(hand) > 21;
 }
 
+/* soft: an ace is still being counted as 11 */
+int hand_is_soft(const Hand *hand) {
+    return hand->aces > 0 && hand->hard + 10 <= 21;
+}
+
+void play_dealer_hand(Hand *dealer, Shoe *shoe) {
+    while (hand_value(dealer) < 17) {
+        hand_add_card(dealer, shoe_deal(shoe));
+    }
+}
+
+int hand_outcome(const Hand *player, const Hand *dealer) {
+    int pv = hand_value(player);
+    int dv = hand_value(dealer);
+    if (pv > 21) return -1;
+    if (dv > 21) return 1;
+    if (pv > dv) return 1;
+    if (pv < dv) return -1;
+    return 0;
+}
+
+/* Cards separated by spaces, cut short (still terminated) if buf is small */
 void hand_to_string(const Hand *hand, char *buf, size_t bufsize) {
-    char tmp[32];
-    buf[0] = '\0';
-    for (int i = 0; i < hand->count; i++) {
-        card_to_string(&hand->cards[i], tmp, sizeof(tmp));
-        if (i > 0) strncat(buf, " ", bufsize - strlen(buf) - 1);
-        strncat(buf, tmp, bufsize - strlen(buf) - 1);
+    if (bufsize == 0) return;
+    size_t len = 0, room = bufsize - 1;
+    for (int i = 0; i < hand->count && len < room; i++) {
+        if (i > 0) buf[len++] = ' ';
+        size_t n = card_name_len(hand->cards[i]);
+        if (n > room - len) n = room - len;
+        memcpy(buf + len, card_names[hand->cards[i] & 63], n);
+        len += n;
     }
+    buf[len] = '\0';
 }
@@ -0,0 +1,105 @@
+#include "../include/broadcast.h"
+#include "../include/stats.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+/* ---------- feed ---------- */
+
+void feed_init(Feed *f) {
+    f->text_len = 0;
+    f->binary_len = 0;
+    f->seat = -1;
+}
+
+int feed_has_room(const Feed *f) {
+    return FEED_SIZE - f->text_len >= PROTO_MAX_MSG &&
+           FEED_SIZE - f->binary_len >= PROTO_MAX_MSG;
+}
+
+void feed_send(Feed *f, int op) {
+    f->text_len += proto_put_simple(f->text + f->text_len, FEED_SIZE - f->text_len, 0, op);
+    f->binary_len += proto_put_simple(f->binary + f->binary_len, FEED_SIZE - f->binary_len, 1, op);
+}
+
+void feed_send_int(Feed *f, int op, int value) {
+    f->text_len += proto_put_int(f->text + f->text_len, FEED_SIZE - f->text_len, 0, op, value);
+    f->binary_len += proto_put_int(f->binary + f->binary_len, FEED_SIZE - f->binary_len, 1, op, value);
+}
+
+void feed_send_card(Feed *f, int op, Card c) {
+    f->text_len += proto_put_card(f->text + f->text_len, FEED_SIZE - f->text_len, 0, op, c);
+    f->binary_len += proto_put_card(f->binary + f->binary_len, FEED_SIZE - f->binary_len, 1, op, c);
+}
+
+void feed_send_hand(Feed *f, int op, const Hand *h) {
+    f->text_len += proto_put_hand(f->text + f->text_len, FEED_SIZE - f->text_len, 0, op, h);
+    f->binary_len += proto_put_hand(f->binary + f->binary_len, FEED_SIZE - f->binary_len, 1, op, h);
+}
+
+/* ---------- broadcasts ---------- */
+
+Broadcast *broadcast_new(const char *data, size_t len) {
+    Broadcast *b = malloc(sizeof(*b) + len);
+    if (!b) return NULL;
+    b->refs = 1;   // the caller's, until broadcast_release()
+    b->len = len;
+    memcpy(b->data, data, len);
+    return b;
+}
+
+static void unref(Broadcast *b) {
+    if (--b->refs == 0) free(b);
+}
+
+void broadcast_release(Broadcast *b) {
+    if (b) unref(b);
+}
+
+/* ---------- spectators ---------- */
+
+void watch_init(Watch *w) {
+    w->head = 0;
+    w->count = 0;
+    w->sent = 0;
+}
+
+int watch_flush(Watch *w, int fd) {
+    while (w->count > 0) {
+        Broadcast *b = w->queue[w->head];
+        ssize_t n = send(fd, b->data + w->sent, b->len - w->sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        stats_count(STAT_SENDS, 1);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        stats_count(STAT_BYTES_OUT, (uint64_t)n);
+        w->sent += (size_t)n;
+        if (w->sent < b->len) return 0;   // the socket is full
+
+        unref(b);
+        w->head = (w->head + 1) % WATCH_BACKLOG;
+        w->count--;
+        w->sent = 0;
+    }
+    return 0;
+}
+
+int watch_push(Watch *w, int fd, Broadcast *b) {
+    if (w->count == WATCH_BACKLOG) return -1;
+    b->refs++;
+    w->queue[(w->head + w->count) % WATCH_BACKLOG] = b;
+    w->count++;
+    return watch_flush(w, fd);
+}
+
+void watch_clear(Watch *w) {
+    while (w->count > 0) {
+        unref(w->queue[w->head]);
+        w->head = (w->head + 1) % WATCH_BACKLOG;
+        w->count--;
+    }
+    w->sent = 0;
+}
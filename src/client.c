@@ -1,183 +1,368 @@
-/*
- * Simple Blackjack Client
- * Connects to a Blackjack server and plays the game based on server prompts.
- * 
- * Usage: ./client <server-ip> <port>
- * 
- * This client handles server messages, displays game state, and prompts the user for actions.
- */
-
- #include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <netinet/in.h>
-#include <sys/socket.h>
-#include <ctype.h>
-
-#define BUFFER_SIZE 512
-
-static void usage(const char *prog) {
-    fprintf(stderr, "Usage: %s <server-ip> <port>\n", prog);
-}
-
-static int recv_line(int fd, char *buf, size_t bufsz) {
-    size_t idx = 0;
-    while (idx + 1 < bufsz) {
-        char c;
-        ssize_t r = recv(fd, &c, 1, 0);
-        if (r <= 0) return -1;  // error or disconnect
-        if (c == '\n') break;
-        buf[idx++] = c;
-    }
-    buf[idx] = '\0';
-    return (int)idx;
-}
-
-static int send_line(int fd, const char *s) {
-    size_t len = strlen(s);
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = send(fd, s + sent, len - sent, 0);
-        if (n <= 0) return -1;
-        sent += (size_t)n;
-    }
-    if (send(fd, "\n", 1, 0) <= 0) return -1;
-    return 0;
-}
-
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        usage(argv[0]);
-        return 1;
-    }
-
-    const char *server_ip = argv[1];
-    int port = atoi(argv[2]);
-
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        perror("socket");
-        return 1;
-    }
-
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port   = htons((uint16_t)port);
-    if (inet_pton(AF_INET, server_ip, &addr.sin_addr) <= 0) {
-        fprintf(stderr, "Invalid address: %s\n", server_ip);
-        close(sock);
-        return 1;
-    }
-
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        perror("connect");
-        close(sock);
-        return 1;
-    }
-
-    printf("Connected to blackjack server %s:%d\n", server_ip, port);
-    printf("Waiting for rounds. Ctrl+C to quit.\n\n");
-
-    char line[BUFFER_SIZE];
-
-    while (1) {
-        int r = recv_line(sock, line, sizeof(line));
-        if (r <= 0) {
-            printf("Connection closed by server.\n");
-            break;
-        }
-
-        // Split into command + rest
-        char *cmd  = strtok(line, " ");
-        char *rest = strtok(NULL, "");
-
-        if (!cmd) continue;
-
-        if (strcmp(cmd, "WELCOME") == 0) {
-            printf("%s %s\n", cmd, rest ? rest : "");
-        }
-        else if (strcmp(cmd, "SERVER_FULL") == 0) {
-            printf("Server is full. Try again later.\n");
-            break;
-        }
-        else if (strcmp(cmd, "DEALER_UP") == 0) {
-            printf("\nDealer shows: %s\n", rest ? rest : "?");
-        }
-        else if (strcmp(cmd, "YOUR_HAND") == 0) {
-            printf("Your initial hand: %s\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "YOUR_TURN") == 0) {
-            printf("\n--- Your turn ---\n");
-        }
-        else if (strcmp(cmd, "HAND") == 0) {
-            printf("Your hand: %s\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "PROMPT") == 0) {
-            // PROMPT HIT or STAND
-            char input[BUFFER_SIZE];
-            printf("Hit or Stand? (h/s): ");
-            fflush(stdout);
-            if (!fgets(input, sizeof(input), stdin)) {
-                // On input failure, default to STAND
-                send_line(sock, "STAND");
-                continue;
-            }
-            char c = (char)tolower((unsigned char)input[0]);
-            if (c == 'h')
-                send_line(sock, "HIT");
-            else
-                send_line(sock, "STAND");
-        }
-        else if (strcmp(cmd, "HIT") == 0) {
-            printf("You drew: %s\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "BUST") == 0) {
-            printf("You busted with %s.\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "STAND") == 0) {
-            printf("You stand with %s.\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "BLACKJACK") == 0) {
-            printf("Blackjack!\n");
-        }
-        else if (strcmp(cmd, "DEALER_HAND") == 0) {
-            printf("\nDealer hand: %s\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "DEALER_VALUE") == 0) {
-            printf("Dealer value: %s\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "PLAYER_VALUE") == 0) {
-            printf("Your value: %s\n", rest ? rest : "");
-        }
-        else if (strcmp(cmd, "RESULT") == 0) {
-            if (!rest) rest = "";
-            if (strcmp(rest, "WIN") == 0)
-                printf("\n>>> You WIN! 🎉\n");
-            else if (strcmp(rest, "LOSE") == 0)
-                printf("\n>>> You lose.\n");
-            else if (strcmp(rest, "PUSH") == 0)
-                printf("\n>>> Push (tie).\n");
-            else
-                printf("\n>>> Result: %s\n", rest);
-        }
-        else if (strcmp(cmd, "ROUND_END") == 0) {
-            // IMPORTANT: don't exit, just wait for next round
-            printf("\n--- Round finished. Waiting for next round... ---\n\n");
-        }
-        else if (strcmp(cmd, "UNKNOWN_COMMAND") == 0) {
-            printf("Server did not understand your command.\n");
-        }
-        else {
-            // Fallback: print unknown lines
-            printf("%s", cmd);
-            if (rest) printf(" %s", rest);
-            printf("\n");
-        }
-    }
-
-    close(sock);
-    return 0;
-}
+/*
+ * Simple Blackjack Client
+ * Connects to a Blackjack server and plays the game based on server prompts.
+ * 
+ * Usage: ./client <server-ip> <port> [--binary] [--watch]
+ * 
+ * This client handles server messages, displays game state, and prompts the user for actions.
+ * With --binary it negotiates the compact framed protocol right after WELCOME.
+ * With --watch it gives up its seat and follows the table as a spectator.
+ */
+
+ #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <ctype.h>
+
+#include "../include/proto.h"
+#include "../include/rxbuf.h"
+
+#define BUFFER_SIZE 512
+
+typedef struct {
+    int sock;
+    int want_binary;   // asked for on the command line
+    int tx_binary;     // our commands are frames once we have asked
+    int binary;        // server frames from its PROTO answer on
+    int want_watch;    // --watch
+    int watching;      // the server acknowledged WATCH
+    int seat;          // spectators: the seat the last SEAT named
+    int done;
+} Client;
+
+typedef void (*Handler)(Client *c, const ProtoMsg *m);
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <server-ip> <port> [--binary] [--watch]\n", prog);
+}
+
+static int send_line(int fd, const char *s) {
+    size_t len = strlen(s);
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(fd, s + sent, len - sent, 0);
+        if (n <= 0) return -1;
+        sent += (size_t)n;
+    }
+    if (send(fd, "\n", 1, 0) <= 0) return -1;
+    return 0;
+}
+
+static int send_command(Client *c, int op) {
+    if (c->tx_binary) {
+        char frame[2] = { 1, (char)op };
+        return send(c->sock, frame, sizeof(frame), 0) == (ssize_t)sizeof(frame) ? 0 : -1;
+    }
+    return send_line(c->sock, proto_op_name(op));
+}
+
+/* "AH 10D" style rendering of the cards carried by a message */
+static const char *cards_str(const ProtoMsg *m, char *buf, size_t bufsize) {
+    Hand h;
+    hand_init(&h);
+    for (int i = 0; i < m->ncards; i++) hand_add_card(&h, m->cards[i]);
+    hand_to_string(&h, buf, bufsize);
+    return buf;
+}
+
+/* ---------- message handlers ---------- */
+
+static void on_welcome(Client *c, const ProtoMsg *m) {
+    printf("WELCOME Player %d\n", m->value);
+    if (c->want_binary && !c->tx_binary) {
+        send_line(c->sock, "PROTO BINARY");
+        c->tx_binary = 1;
+    }
+    if (c->want_watch) send_command(c, OP_WATCH);
+}
+
+static void on_proto(Client *c, const ProtoMsg *m) {
+    (void)m;
+    c->binary = 1;
+}
+
+static void on_server_full(Client *c, const ProtoMsg *m) {
+    (void)m;
+    printf("Server is full. Try again later.\n");
+    c->done = 1;
+}
+
+static void on_dealer_up(Client *c, const ProtoMsg *m) {
+    char buf[64];
+    (void)c;
+    printf("\nDealer shows: %s\n", cards_str(m, buf, sizeof(buf)));
+}
+
+static void on_watch(Client *c, const ProtoMsg *m) {
+    (void)m;
+    c->watching = 1;
+    printf("Watching the table from the next deal.\n");
+}
+
+static void on_seat(Client *c, const ProtoMsg *m) {
+    c->seat = m->value;
+}
+
+static void on_your_hand(Client *c, const ProtoMsg *m) {
+    char buf[64];
+    (void)c;
+    printf("Your initial hand: %s\n", cards_str(m, buf, sizeof(buf)));
+}
+
+static void on_your_turn(Client *c, const ProtoMsg *m) {
+    (void)m;
+    if (c->watching)
+        printf("\n--- Seat %d's turn ---\n", c->seat);
+    else
+        printf("\n--- Your turn ---\n");
+}
+
+static void on_hand(Client *c, const ProtoMsg *m) {
+    char buf[64];
+    if (c->watching)
+        printf("Seat %d's hand: %s\n", c->seat, cards_str(m, buf, sizeof(buf)));
+    else
+        printf("Your hand: %s\n", cards_str(m, buf, sizeof(buf)));
+}
+
+static void on_prompt(Client *c, const ProtoMsg *m) {
+    // PROMPT HIT or STAND
+    char input[BUFFER_SIZE];
+    (void)m;
+    printf("Hit or Stand? (h/s, ? for a hint): ");
+    fflush(stdout);
+    if (!fgets(input, sizeof(input), stdin)) {
+        // On input failure, default to STAND
+        send_command(c, OP_STAND);
+        return;
+    }
+    char ch = (char)tolower((unsigned char)input[0]);
+    if (ch == '?')
+        send_command(c, OP_HINT);
+    else if (ch == 'h')
+        send_command(c, OP_HIT);
+    else
+        send_command(c, OP_STAND);
+}
+
+static void on_hit(Client *c, const ProtoMsg *m) {
+    char buf[64];
+    if (c->watching)
+        printf("Seat %d drew: %s\n", c->seat, cards_str(m, buf, sizeof(buf)));
+    else
+        printf("You drew: %s\n", cards_str(m, buf, sizeof(buf)));
+}
+
+static void on_bust(Client *c, const ProtoMsg *m) {
+    if (c->watching)
+        printf("Seat %d busted with %d.\n", c->seat, m->value);
+    else
+        printf("You busted with %d.\n", m->value);
+}
+
+static void on_stand(Client *c, const ProtoMsg *m) {
+    if (c->watching)
+        printf("Seat %d stands with %d.\n", c->seat, m->value);
+    else
+        printf("You stand with %d.\n", m->value);
+}
+
+static void on_blackjack(Client *c, const ProtoMsg *m) {
+    (void)m;
+    if (c->watching)
+        printf("Seat %d: Blackjack!\n", c->seat);
+    else
+        printf("Blackjack!\n");
+}
+
+static void on_dealer_hand(Client *c, const ProtoMsg *m) {
+    char buf[64];
+    (void)c;
+    printf("\nDealer hand: %s\n", cards_str(m, buf, sizeof(buf)));
+}
+
+static void on_dealer_value(Client *c, const ProtoMsg *m) {
+    (void)c;
+    printf("Dealer value: %d\n", m->value);
+}
+
+static void on_player_value(Client *c, const ProtoMsg *m) {
+    if (c->watching)
+        printf("Seat %d value: %d\n", c->seat, m->value);
+    else
+        printf("Your value: %d\n", m->value);
+}
+
+static void on_result(Client *c, const ProtoMsg *m) {
+    if (c->watching) {
+        static const char *verdict[] = { "loses", "wins", "pushes" };
+        printf(">>> Seat %d %s.\n", c->seat, verdict[m->value <= RESULT_PUSH ? m->value : RESULT_PUSH]);
+        return;
+    }
+    if (m->value == RESULT_WIN)
+        printf("\n>>> You WIN! 🎉\n");
+    else if (m->value == RESULT_LOSE)
+        printf("\n>>> You lose.\n");
+    else
+        printf("\n>>> Push (tie).\n");
+}
+
+static void on_round_end(Client *c, const ProtoMsg *m) {
+    (void)m;
+    if (c->watching) {
+        printf("\n--- Round finished ---\n\n");
+        return;
+    }
+    // IMPORTANT: don't exit, just wait for next round
+    printf("\n--- Round finished. Waiting for next round... ---\n\n");
+}
+
+static void on_hint(Client *c, const ProtoMsg *m) {
+    (void)c;
+    printf("Hint: %s\n", m->value == HINT_HIT ? "hit" : "stand");
+}
+
+static void on_unknown_command(Client *c, const ProtoMsg *m) {
+    (void)c; (void)m;
+    printf("Server did not understand your command.\n");
+}
+
+static const Handler handlers[OP_COUNT] = {
+    [OP_WELCOME]         = on_welcome,
+    [OP_SERVER_FULL]     = on_server_full,
+    [OP_DEALER_UP]       = on_dealer_up,
+    [OP_YOUR_HAND]       = on_your_hand,
+    [OP_YOUR_TURN]       = on_your_turn,
+    [OP_HAND]            = on_hand,
+    [OP_PROMPT]          = on_prompt,
+    [OP_HIT]             = on_hit,
+    [OP_STAND]           = on_stand,
+    [OP_BUST]            = on_bust,
+    [OP_BLACKJACK]       = on_blackjack,
+    [OP_DEALER_HAND]     = on_dealer_hand,
+    [OP_DEALER_VALUE]    = on_dealer_value,
+    [OP_PLAYER_VALUE]    = on_player_value,
+    [OP_RESULT]          = on_result,
+    [OP_ROUND_END]       = on_round_end,
+    [OP_UNKNOWN_COMMAND] = on_unknown_command,
+    [OP_PROTO]           = on_proto,
+    [OP_HINT]            = on_hint,
+    [OP_SEAT]            = on_seat,
+    [OP_WATCH]           = on_watch,
+};
+
+/* ---------- receiving ---------- */
+
+/* Blocking read of the next server line, served from rx when possible */
+static char *recv_line(int fd, RxBuf *rx) {
+    char *line;
+    while ((line = rxbuf_next_line(rx, NULL)) == NULL) {
+        if (rxbuf_fill(rx, fd, 0) <= 0) return NULL;  // error or disconnect
+    }
+    return line;
+}
+
+static unsigned char *recv_frame(int fd, RxBuf *rx, size_t *len) {
+    unsigned char *f;
+    while ((f = rxbuf_next_frame(rx, len)) == NULL) {
+        if (rxbuf_fill(rx, fd, 0) <= 0) return NULL;  // error or disconnect
+    }
+    return f;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    int want_binary = 0, want_watch = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--binary") == 0) {
+            want_binary = 1;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            want_watch = 1;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    const char *server_ip = argv[1];
+    int port = atoi(argv[2]);
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons((uint16_t)port);
+    if (inet_pton(AF_INET, server_ip, &addr.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid address: %s\n", server_ip);
+        close(sock);
+        return 1;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(sock);
+        return 1;
+    }
+
+    printf("Connected to blackjack server %s:%d\n", server_ip, port);
+    printf("Waiting for rounds. Ctrl+C to quit.\n\n");
+
+    Client c;
+    memset(&c, 0, sizeof(c));
+    c.sock = sock;
+    c.want_binary = want_binary;
+    c.want_watch = want_watch;
+
+    RxBuf rx;
+    rxbuf_init(&rx);
+
+    while (!c.done) {
+        ProtoMsg m;
+        int bad;
+        char *line = NULL;
+
+        if (c.binary) {
+            size_t len;
+            unsigned char *f = recv_frame(sock, &rx, &len);
+            if (!f) {
+                printf("Connection closed by server.\n");
+                break;
+            }
+            bad = proto_decode_frame(f, len, &m) < 0;
+        } else {
+            line = recv_line(sock, &rx);
+            if (!line) {
+                printf("Connection closed by server.\n");
+                break;
+            }
+            bad = proto_decode_line(line, &m) < 0;
+        }
+
+        Handler h = bad ? NULL : handlers[m.op];
+        if (h) {
+            h(&c, &m);
+        } else if (line) {
+            // Fallback: print unknown lines
+            printf("%s", line);
+            if (m.arg) printf(" %s", m.arg);
+            printf("\n");
+        } else {
+            printf("Unknown message (opcode %d)\n", m.op);
+        }
+    }
+
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,633 @@
+#include "../include/conn.h"
+#include "../include/shm.h"
+#include "../include/stats.h"
+#include "../include/uring.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+int conn_use_cork = 0;
+
+/* Connections retired during an event batch; freed once the batch is done
+ * so that no pending epoll event can point at released memory. Each shard
+ * thread keeps its own list. */
+static __thread PlayerConn *retired = NULL;
+
+/* ---------- helpers for sending / receiving ---------- */
+
+ssize_t send_all(int fd, const char *buf, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(fd, buf + sent, len - sent, MSG_NOSIGNAL);
+        stats_count(STAT_SENDS, 1);
+        if (n <= 0) return n;
+        stats_count(STAT_BYTES_OUT, (uint64_t)n);
+        sent += (size_t)n;
+    }
+    return (ssize_t)sent;
+}
+
+int send_simple(int fd, int op) {
+    char buf[PROTO_MAX_MSG];
+    size_t n = proto_put_simple(buf, sizeof(buf), 0, op);
+    if (n == 0) return -1;
+    return (send_all(fd, buf, n) > 0) ? 0 : -1;
+}
+
+/* ---------- output queue ---------- */
+
+static void set_cork(PlayerConn *pc, int on) {
+    setsockopt(pc->socket_fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+    pc->corked = on;
+}
+
+static __thread TimerWheel *timers = NULL;
+
+int conn_stall_timeout_ms = 10000;
+
+void conn_set_timers(TimerWheel *w) {
+    timers = w;
+}
+
+/* One non-blocking send(): the bytes taken, 0 if none fit, -1 on failure */
+static ssize_t send_now(PlayerConn *pc, const char *buf, size_t len) {
+    if (pc->shm) {
+        size_t put = shm_send(pc->shm, buf, len);
+        stats_count(STAT_BYTES_OUT, put);
+        return (ssize_t)put;
+    }
+    ssize_t n = send(pc->socket_fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    stats_count(STAT_SENDS, 1);
+    if (n >= 0) {
+        stats_count(STAT_BYTES_OUT, (uint64_t)n);
+        return n;
+    }
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+}
+
+static void arm_stall(PlayerConn *pc, uint64_t delay_ms) {
+    if (timers && pc->stall.fn) timer_arm(timers, &pc->stall, timer_now_ms() + delay_ms);
+}
+
+/* Over budget: the stall timer fires on the next run and its owner evicts */
+static int overflow(PlayerConn *pc) {
+    pc->evict = 1;
+    arm_stall(pc, 0);
+    return -1;
+}
+
+static int backlog_append(PlayerConn *pc, const char *buf, size_t len) {
+    if (pc->backlog_len + len > CONN_TX_BUDGET) return overflow(pc);
+    if (!pc->backlog) {
+        pc->backlog = malloc(CONN_TX_BUDGET);
+        if (!pc->backlog) return overflow(pc);
+    }
+    if (pc->backlog_len == 0) {
+        pc->backlog_off = 0;
+        pc->stall_ns = stats_clock();
+        stats_count(STAT_TX_STALLS, 1);
+        if (conn_stall_timeout_ms > 0) arm_stall(pc, (uint64_t)conn_stall_timeout_ms);
+    } else if (pc->backlog_off + pc->backlog_len + len > CONN_TX_BUDGET) {
+        memmove(pc->backlog, pc->backlog + pc->backlog_off, pc->backlog_len);
+        pc->backlog_off = 0;
+    }
+    memcpy(pc->backlog + pc->backlog_off + pc->backlog_len, buf, len);
+    pc->backlog_len += len;
+    stats_count(STAT_TX_BACKLOG, len);
+    if (pc->backlog_len > CONN_TX_HIGH) pc->congested = 1;
+    return 0;
+}
+
+/* With a ring, what send_out() would have written waits in the backlog for
+ * the next batch; only one send per connection is in flight, and the
+ * backlog is kept at offset 0 so appends never move the bytes it reads */
+static __thread Uring *ring = NULL;
+static __thread PlayerConn *tx_ready = NULL;
+
+/* Receives that ended -ENOBUFS wait here until a buffer comes back, rather
+ * than going straight back to the same empty ring */
+static __thread PlayerConn *rx_parked = NULL;
+static __thread int bufs_back = 0;
+
+static void park(PlayerConn *pc) {
+    if (pc->pprev_parked) return;
+    pc->next_parked = rx_parked;
+    if (rx_parked) rx_parked->pprev_parked = &pc->next_parked;
+    pc->pprev_parked = &rx_parked;
+    rx_parked = pc;
+}
+
+static void unpark(PlayerConn *pc) {
+    if (!pc->pprev_parked) return;
+    *pc->pprev_parked = pc->next_parked;
+    if (pc->next_parked) pc->next_parked->pprev_parked = pc->pprev_parked;
+    pc->next_parked = NULL;
+    pc->pprev_parked = NULL;
+}
+
+static void buf_return(unsigned id) {
+    uring_buf_return(ring, id);
+    bufs_back = 1;
+}
+
+static void list_tx(PlayerConn *pc) {
+    if (pc->tx_listed || pc->tx_inflight) return;
+    pc->tx_listed = 1;
+    pc->next_tx = tx_ready;
+    tx_ready = pc;
+}
+
+static int ring_queue(PlayerConn *pc, const char *buf, size_t len) {
+    if (pc->backlog_len + len > CONN_TX_BUDGET) return overflow(pc);
+    if (!pc->backlog) {
+        pc->backlog = malloc(CONN_TX_BUDGET);
+        if (!pc->backlog) return overflow(pc);
+    }
+    // last batch's send still hasn't finished: the socket is full
+    if (pc->tx_inflight && !pc->stalled) {
+        pc->stalled = 1;
+        pc->stall_ns = stats_clock();
+        stats_count(STAT_TX_STALLS, 1);
+        if (conn_stall_timeout_ms > 0) arm_stall(pc, (uint64_t)conn_stall_timeout_ms);
+    }
+    memcpy(pc->backlog + pc->backlog_len, buf, len);
+    pc->backlog_len += len;
+    stats_count(STAT_TX_BACKLOG, len);
+    if (pc->backlog_len > CONN_TX_HIGH) pc->congested = 1;
+    list_tx(pc);
+    return 0;
+}
+
+int conn_drain(PlayerConn *pc) {
+    if (ring && !pc->shm) return 0;   // the ring's send owns the backlog
+    if (pc->backlog_len == 0 || pc->socket_fd < 0) return 0;
+    ssize_t n = send_now(pc, pc->backlog + pc->backlog_off, pc->backlog_len);
+    if (n < 0) return -1;
+    if (n == 0) return 0;
+
+    pc->backlog_off += (size_t)n;
+    pc->backlog_len -= (size_t)n;
+    stats_uncount(STAT_TX_BACKLOG, (uint64_t)n);
+    if (pc->backlog_len <= CONN_TX_LOW) pc->congested = 0;
+    if (pc->backlog_len == 0) {
+        stats_phase(PHASE_STALL, pc->stall_ns);
+        if (timers && !pc->evict) timer_cancel(timers, &pc->stall);
+    } else if (conn_stall_timeout_ms > 0 && !pc->evict) {
+        arm_stall(pc, (uint64_t)conn_stall_timeout_ms);   // progress: a fresh deadline
+    }
+    return 0;
+}
+
+size_t conn_take_backlog(PlayerConn *pc, const char **data) {
+    size_t len = pc->backlog_len;
+    *data = pc->backlog ? pc->backlog + pc->backlog_off : NULL;
+    stats_uncount(STAT_TX_BACKLOG, len);
+    pc->backlog_len = 0;
+    pc->congested = 0;
+    pc->stalled = 0;
+    if (timers && !pc->evict) timer_cancel(timers, &pc->stall);
+    return len;
+}
+
+static int send_out(PlayerConn *pc) {
+    if (pc->out_len == 0 || pc->socket_fd < 0) return 0;
+    const char *p = pc->out;
+    size_t len = pc->out_len;
+    pc->out_len = 0;
+    if (pc->evict) return -1;
+    if (ring && !pc->shm) return ring_queue(pc, p, len);
+
+    // nothing waiting ahead of it: straight to the socket
+    if (pc->backlog_len == 0) {
+        ssize_t n = send_now(pc, p, len);
+        if (n < 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        if (len == 0) return 0;
+    }
+    return backlog_append(pc, p, len);
+}
+
+int conn_flush(PlayerConn *pc) {
+    int rc = send_out(pc);
+    if (pc->corked) set_cork(pc, 0);
+    return rc;
+}
+
+/* Room for one more message; if the phase outgrew the buffer, what is
+ * queued goes out now, corked so the kernel holds the partial segment
+ * until conn_flush() */
+static char *out_reserve(PlayerConn *pc) {
+    if (sizeof(pc->out) - pc->out_len >= PROTO_MAX_MSG) return pc->out + pc->out_len;
+    if (conn_use_cork && !ring && !pc->shm && !pc->corked) set_cork(pc, 1);
+    if (send_out(pc) < 0) return NULL;
+    return pc->out;
+}
+
+void conn_send(PlayerConn *pc, int op) {
+    char *p = out_reserve(pc);
+    if (p) pc->out_len += proto_put_simple(p, sizeof(pc->out) - pc->out_len, pc->binary, op);
+}
+
+void conn_send_int(PlayerConn *pc, int op, int value) {
+    char *p = out_reserve(pc);
+    if (p) pc->out_len += proto_put_int(p, sizeof(pc->out) - pc->out_len, pc->binary, op, value);
+}
+
+void conn_send_card(PlayerConn *pc, int op, Card c) {
+    char *p = out_reserve(pc);
+    if (p) pc->out_len += proto_put_card(p, sizeof(pc->out) - pc->out_len, pc->binary, op, c);
+}
+
+void conn_send_hand(PlayerConn *pc, int op, const Hand *h) {
+    char *p = out_reserve(pc);
+    if (p) pc->out_len += proto_put_hand(p, sizeof(pc->out) - pc->out_len, pc->binary, op, h);
+}
+
+/* ---------- receiving ---------- */
+
+static void upcase(char *p, size_t n) {
+    for (size_t i = 0; i < n; i++) p[i] = (char)toupper((unsigned char)p[i]);
+}
+
+/* Opcode of the next buffered message without consuming it: OP_NONE if it
+ * is not a known command, -1 if no complete message is buffered */
+static int peek_op(PlayerConn *pc) {
+    size_t len;
+    if (pc->binary) {
+        const unsigned char *f = rxbuf_peek_frame(&pc->rx, &len);
+        if (!f) return -1;
+        return len ? f[0] : OP_NONE;
+    }
+
+    const char *line = rxbuf_peek_line(&pc->rx, &len);
+    if (!line) return -1;
+    char word[32];
+    size_t w = 0;
+    while (w < len && w < sizeof(word) && line[w] != ' ') {
+        word[w] = line[w];
+        w++;
+    }
+    upcase(word, w);
+    return proto_text_op(word, w);
+}
+
+/* Consume and decode the next buffered message; 0 if none is complete */
+static int next_msg(PlayerConn *pc, ProtoMsg *m) {
+    size_t len;
+    if (pc->binary) {
+        unsigned char *f = rxbuf_next_frame(&pc->rx, &len);
+        if (!f) return 0;
+        proto_decode_frame(f, len, m);
+        return 1;
+    }
+
+    char *line = rxbuf_next_line(&pc->rx, &len);
+    if (!line) return 0;
+    upcase(line, len);
+    proto_decode_line(line, m);
+    // a text decision is the bare keyword: "HIT ME" is not a HIT
+    if ((m->op == OP_HIT || m->op == OP_STAND || m->op == OP_HINT || m->op == OP_WATCH) && m->arg)
+        m->op = OP_NONE;
+    return 1;
+}
+
+static void handle_control(PlayerConn *pc, const ProtoMsg *m) {
+    if (m->op == OP_PROTO && !pc->binary && m->arg && strcmp(m->arg, "BINARY") == 0) {
+        // the acknowledgement is the last text the client will see
+        conn_send(pc, OP_PROTO);
+        conn_flush(pc);
+        pc->binary = 1;
+        return;
+    }
+    conn_send(pc, OP_UNKNOWN_COMMAND);
+    conn_flush(pc);
+}
+
+/* Moves held receive buffers into rx as far as it has room; bytes moved */
+static size_t take_held(PlayerConn *pc) {
+    size_t moved = 0;
+    while (pc->rx_held_n) {
+        unsigned id = pc->rx_held[0];
+        size_t len = pc->rx_held_len[0] - pc->rx_held_off;
+        size_t n = rxbuf_append(&pc->rx, uring_buf(ring, id) + pc->rx_held_off, len);
+        moved += n;
+        if (n < len) {
+            pc->rx_held_off += n;
+            break;
+        }
+        buf_return(id);
+        pc->rx_held_off = 0;
+        pc->rx_held_n--;
+        memmove(pc->rx_held, pc->rx_held + 1, pc->rx_held_n * sizeof(pc->rx_held[0]));
+        memmove(pc->rx_held_len, pc->rx_held_len + 1, pc->rx_held_n * sizeof(pc->rx_held_len[0]));
+    }
+    return moved;
+}
+
+/* A local bot's ring, straight into rx; at its end, ask for the doorbell */
+static int fill_shm(PlayerConn *pc) {
+    const char *p;
+    size_t n = shm_peek(pc->shm, &p);
+    if (n == 0) {
+        if (pc->rx_closed) return -1;
+        if (shm_idle(pc->shm)) return 0;
+        n = shm_peek(pc->shm, &p);
+    }
+    size_t took = rxbuf_append(&pc->rx, p, n);
+    if (took == 0) return -1;   // as with recv(), rx can never yield a message
+    shm_consume(pc->shm, took);
+    stats_count(STAT_BYTES_IN, took);
+    return 1;
+}
+
+static int fill(PlayerConn *pc) {
+    if (pc->shm) return fill_shm(pc);
+    if (ring) {
+        // completions fill rx; what did not fit is taken now, and only once
+        // it is all in does the receive start again
+        if (pc->rx_held_n) return take_held(pc) ? 1 : -1;
+        if (pc->rx_closed) return -1;
+        if (pc->rx_armed || pc->pprev_parked) return 0;
+        if (rxbuf_room(&pc->rx) == 0) return -1;   // can never yield a message
+        return conn_start_recv(pc) < 0 ? -1 : 0;
+    }
+    ssize_t r = rxbuf_fill(&pc->rx, pc->socket_fd, MSG_DONTWAIT);
+    stats_count(STAT_RECVS, 1);
+    if (r > 0) {
+        stats_count(STAT_BYTES_IN, (uint64_t)r);
+        return 1;
+    }
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return -1;   // disconnect, or a buffer that can never yield a message
+}
+
+int conn_recv_msg(PlayerConn *pc, ProtoMsg *m) {
+    while (1) {
+        if (next_msg(pc, m)) {
+            if (m->op == OP_PROTO) {
+                handle_control(pc, m);
+                continue;
+            }
+            return 1;
+        }
+        int r = fill(pc);
+        if (r <= 0) return r;
+    }
+}
+
+int conn_pump(PlayerConn *pc) {
+    while (1) {
+        int op = peek_op(pc);
+        if (op == OP_PROTO) {
+            ProtoMsg m;
+            next_msg(pc, &m);
+            handle_control(pc, &m);
+            continue;
+        }
+        if (op == OP_WATCH) {
+            ProtoMsg m;
+            next_msg(pc, &m);
+            if (m.op == OP_WATCH) return 1;
+            handle_control(pc, &m);   // "WATCH something": not a command
+            continue;
+        }
+        if (op != -1) return 0;   // a decision: it waits for the player's turn
+
+        int r = fill(pc);
+        if (r <= 0) return r;
+    }
+}
+
+int conn_discard_input(PlayerConn *pc) {
+    while (1) {
+        rxbuf_init(&pc->rx);
+        int r = fill(pc);
+        if (r <= 0) return r;
+    }
+}
+
+/* ---------- io_uring ---------- */
+
+void conn_set_ring(Uring *u) {
+    ring = u;
+}
+
+int conn_start_recv(PlayerConn *pc) {
+    // a client that has run ahead of its turn is given no more than fits;
+    // the rest waits in the socket as it would under epoll
+    size_t room = rxbuf_room(&pc->rx);
+    if (room == 0) return 0;
+    struct io_uring_sqe *sqe = uring_sqe(ring);
+    if (!sqe) return -1;
+    uint64_t ud = (uint64_t)(uintptr_t)pc | CONN_IO_RECV;
+    if (pc->rx_capped) uring_prep_recv_select(sqe, pc->socket_fd, (unsigned)room, ud);
+    else uring_prep_recv_multishot(sqe, pc->socket_fd, ud);
+    pc->ring_ops++;
+    pc->rx_armed = 1;
+    return 0;
+}
+
+/* A multishot receive brought more than rx holds: keep the buffer for
+ * fill() and end the receive; later receives are capped */
+static void hold(PlayerConn *pc, unsigned id, size_t len, size_t taken) {
+    pc->rx_capped = 1;
+    if (pc->rx_held_n == CONN_RX_HELD) {
+        buf_return(id);
+        pc->rx_closed = 1;   // far more unread input than any message needs
+        return;
+    }
+    if (pc->rx_held_n == 0) pc->rx_held_off = taken;
+    pc->rx_held[pc->rx_held_n] = (unsigned short)id;
+    pc->rx_held_len[pc->rx_held_n] = (unsigned short)len;
+    pc->rx_held_n++;
+
+    struct io_uring_sqe *sqe;
+    if (pc->rx_armed && (sqe = uring_sqe(ring)))
+        uring_prep_cancel(sqe, (uint64_t)(uintptr_t)pc | CONN_IO_RECV, CONN_IO_NONE);
+}
+
+static void release_held(PlayerConn *pc) {
+    for (int i = 0; i < pc->rx_held_n; i++) buf_return(pc->rx_held[i]);
+    pc->rx_held_n = 0;
+}
+
+void conn_resume_recvs(void) {
+    if (!bufs_back) return;
+    bufs_back = 0;
+    // those that find the ring empty again park until the next return
+    PlayerConn *pc = rx_parked;
+    rx_parked = NULL;
+    while (pc) {
+        PlayerConn *next = pc->next_parked;
+        pc->next_parked = NULL;
+        pc->pprev_parked = NULL;
+        if (conn_start_recv(pc) < 0) park(pc);
+        pc = next;
+    }
+}
+
+int conn_submit_sends(void) {
+    int n = 0;
+    while (tx_ready) {
+        PlayerConn *pc = tx_ready;
+        tx_ready = pc->next_tx;
+        pc->next_tx = NULL;
+        pc->tx_listed = 0;
+        if (!pc->active || pc->backlog_len == 0 || pc->tx_inflight) continue;
+
+        struct io_uring_sqe *sqe = uring_sqe(ring);
+        if (!sqe) {
+            overflow(pc);
+            continue;
+        }
+        uring_prep_send(sqe, pc->socket_fd, pc->backlog, pc->backlog_len,
+                        (uint64_t)(uintptr_t)pc | CONN_IO_SEND);
+        pc->tx_inflight = pc->backlog_len;
+        pc->ring_ops++;
+        n++;
+    }
+    return n;
+}
+
+int conn_recv_done(PlayerConn *pc, int res, unsigned flags) {
+    if (!(flags & IORING_CQE_F_MORE)) {
+        pc->ring_ops--;
+        pc->rx_armed = 0;
+    }
+    if (flags & IORING_CQE_F_BUFFER) {
+        unsigned id = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (pc->active && res > 0) {
+            stats_count(STAT_BYTES_IN, (uint64_t)res);
+            // behind held input it queues too, to keep the order
+            size_t n = pc->rx_held_n ? 0 : rxbuf_append(&pc->rx, uring_buf(ring, id), (size_t)res);
+            if (n < (size_t)res) hold(pc, id, (size_t)res, n);
+            else buf_return(id);
+        } else {
+            buf_return(id);
+        }
+    }
+    if (!pc->active) return 0;
+
+    if (res == -ENOBUFS && !pc->rx_armed) {
+        stats_count(STAT_RX_NOBUFS, 1);
+        if (!pc->rx_held_n) park(pc);
+        return 0;
+    }
+    if (res == 0 || (res < 0 && res != -ECANCELED)) pc->rx_closed = 1;
+    else if (!pc->rx_armed && !pc->rx_held_n && conn_start_recv(pc) < 0) pc->rx_closed = 1;
+    return pc->rx_closed ? -1 : 1;
+}
+
+int conn_send_done(PlayerConn *pc, int res) {
+    pc->ring_ops--;
+    pc->tx_inflight = 0;
+    if (!pc->active) return 0;
+    if (res < 0) {
+        pc->rx_closed = 1;
+        return -1;
+    }
+
+    size_t n = (size_t)res;
+    stats_count(STAT_BYTES_OUT, n);
+    pc->backlog_len -= n;
+    if (pc->backlog_len) memmove(pc->backlog, pc->backlog + n, pc->backlog_len);
+    stats_uncount(STAT_TX_BACKLOG, n);
+    if (pc->backlog_len <= CONN_TX_LOW) pc->congested = 0;
+
+    if (pc->backlog_len) {
+        list_tx(pc);
+        if (pc->stalled && n && conn_stall_timeout_ms > 0 && !pc->evict)
+            arm_stall(pc, (uint64_t)conn_stall_timeout_ms);   // progress: a fresh deadline
+    } else if (pc->stalled) {
+        pc->stalled = 0;
+        stats_phase(PHASE_STALL, pc->stall_ns);
+        if (timers && !pc->evict) timer_cancel(timers, &pc->stall);
+    }
+    return 0;
+}
+
+/* ---------- shared memory ---------- */
+
+int conn_attach_shm(PlayerConn *pc) {
+    ShmLink *l = malloc(sizeof(*l));
+    if (!l) return -1;
+    if (shm_link_create(l, pc->socket_fd) < 0) {
+        free(l);
+        return -1;
+    }
+    pc->shm = l;
+    return 0;
+}
+
+static void detach_shm(PlayerConn *pc) {
+    if (!pc->shm) return;
+    shm_link_close(pc->shm);
+    free(pc->shm);
+    pc->shm = NULL;
+}
+
+/* ---------- lifetime ---------- */
+
+/* The calling thread's session pool; without one sessions come from calloc */
+static __thread Pool *sessions = NULL;
+
+void conn_set_pool(Pool *p) {
+    sessions = p;
+}
+
+PlayerConn *conn_new(void) {
+    return sessions ? pool_alloc(sessions) : calloc(1, sizeof(PlayerConn));
+}
+
+void conn_free(PlayerConn *pc) {
+    if (!pc) return;
+    detach_shm(pc);
+    free(pc->backlog);
+    if (sessions) pool_free(sessions, pc);
+    else free(pc);
+}
+
+void conn_retire(PlayerConn *pc) {
+    if (!pc->active) return;
+    // requests on the ring hold the socket open; this ends them
+    if (ring && pc->socket_fd >= 0) shutdown(pc->socket_fd, SHUT_RDWR);
+    if (ring) {
+        unpark(pc);
+        release_held(pc);
+    }
+    detach_shm(pc);
+    if (pc->socket_fd >= 0) close(pc->socket_fd);
+    pc->socket_fd = -1;
+    pc->active = 0;
+    if (timers) timer_cancel(timers, &pc->stall);
+    stats_uncount(STAT_TX_BACKLOG, pc->backlog_len);
+    stats_count(STAT_CLOSES, 1);
+    pc->next_retired = retired;
+    retired = pc;
+}
+
+int conn_reap(void) {
+    int n = 0;
+    PlayerConn *busy = NULL;
+    while (retired) {
+        PlayerConn *pc = retired;
+        retired = pc->next_retired;
+        // the ring still has completions naming it: they come first
+        if (pc->ring_ops > 0 || pc->tx_listed) {
+            pc->next_retired = busy;
+            busy = pc;
+            continue;
+        }
+        conn_free(pc);
+        n++;
+    }
+    retired = busy;
+    return n;
+}
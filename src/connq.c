@@ -0,0 +1,68 @@
+#include "../include/connq.h"
+#include <stdlib.h>
+
+int connq_init(ConnQueue *q, size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    q->cells = malloc(cap * sizeof(*q->cells));
+    if (!q->cells) return -1;
+    for (size_t i = 0; i < cap; i++) q->cells[i].seq = i;
+    q->mask = cap - 1;
+    q->head = 0;
+    q->tail = 0;
+    return 0;
+}
+
+void connq_destroy(ConnQueue *q) {
+    free(q->cells);
+    q->cells = NULL;
+}
+
+int connq_push(ConnQueue *q, const PendingConn *pc) {
+    size_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        ConnQueueCell *cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        long diff = (long)seq - (long)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->item = *pc;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1;   // full
+        } else {
+            pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int connq_pop(ConnQueue *q, PendingConn *out) {
+    size_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    for (;;) {
+        ConnQueueCell *cell = &q->cells[pos & q->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        long diff = (long)seq - (long)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *out = cell->item;
+                __atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+        } else if (diff < 0) {
+            return -1;   // empty
+        } else {
+            pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+size_t connq_depth(const ConnQueue *q) {
+    size_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    return tail > head ? tail - head : 0;
+}
@@ -1,67 +1,37 @@
 #include "../include/deck.h"
 #include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-#include <unistd.h>
+#include <string.h>
 
-void deck_init(Deck *deck) {
+#define CARD_ROW(rank, s) \
+    [(rank) << 2 | 0] = s "C", [(rank) << 2 | 1] = s "D", \
+    [(rank) << 2 | 2] = s "H", [(rank) << 2 | 3] = s "S"
+
+const char card_names[64][4] = {
+    CARD_ROW(1, "A"),  CARD_ROW(2, "2"),  CARD_ROW(3, "3"),  CARD_ROW(4, "4"),
+    CARD_ROW(5, "5"),  CARD_ROW(6, "6"),  CARD_ROW(7, "7"),  CARD_ROW(8, "8"),
+    CARD_ROW(9, "9"),  CARD_ROW(10, "10"), CARD_ROW(11, "J"), CARD_ROW(12, "Q"),
+    CARD_ROW(13, "K"),
+};
+
+void deck_fill(Card *cards) {
     int idx = 0;
     for (int suit = 0; suit < 4; suit++) {
         for (int rank = 1; rank <= 13; rank++) {
-            deck->cards[idx].rank = rank;
-            deck->cards[idx].suit = suit;
-            idx++;
+            cards[idx++] = card_make(rank, suit);
         }
     }
-    deck->top = 0;
-}
-
-void deck_shuffle(Deck *deck) {
-    static int seeded = 0;
-    if (!seeded) {
-        unsigned int seed = (unsigned int)(time(NULL) ^ (getpid() << 16));
-        srand(seed);
-        seeded = 1;
-    }
-
-    for (int i = DECK_SIZE - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
-        Card tmp = deck->cards[i];
-        deck->cards[i] = deck->cards[j];
-        deck->cards[j] = tmp;
-    }
-    deck->top = 0;
 }
 
-Card deck_deal(Deck *deck) {
-    if (deck->top >= DECK_SIZE) {
-        deck_shuffle(deck);
+const char *card_to_string(Card card, char *buf, size_t bufsize) {
+    if (bufsize == 0) return buf;
+    size_t n = card_name_len(card);
+    if (n == 0) {
+        // a byte with no rank 1-13 in it: spelled out as before
+        snprintf(buf, bufsize, "%d%c", card_rank(card), "CDHS"[card_suit(card)]);
+        return buf;
     }
-    return deck->cards[deck->top++];
-}
-
-const char *card_to_string(const Card *card, char *buf, size_t bufsize) {
-    const char *rank_s;
-    char rank_buf[4];
-
-    if (card->rank == 1) rank_s = "A";
-    else if (card->rank == 11) rank_s = "J";
-    else if (card->rank == 12) rank_s = "Q";
-    else if (card->rank == 13) rank_s = "K";
-    else {
-        snprintf(rank_buf, sizeof(rank_buf), "%d", card->rank);
-        rank_s = rank_buf;
-    }
-
-    char suit_c;
-    switch (card->suit) {
-        case 0: suit_c = 'C'; break;
-        case 1: suit_c = 'D'; break;
-        case 2: suit_c = 'H'; break;
-        case 3: suit_c = 'S'; break;
-        default: suit_c = '?'; break;
-    }
-
-    snprintf(buf, bufsize, "%s%c", rank_s, suit_c);
+    if (n > bufsize - 1) n = bufsize - 1;
+    memcpy(buf, card_names[card & 63], n);
+    buf[n] = '\0';
     return buf;
 }
@@ -0,0 +1,342 @@
+#include "../include/ev.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAP_INITIAL (1u << 12)
+
+/* ---------- composition ---------- */
+
+static int points(Card card) {
+    int r = card_rank(card);
+    return r > 10 ? 10 : r;
+}
+
+void ev_comp_decks(EvComp *c, int ndecks) {
+    memset(c, 0, sizeof(*c));
+    for (int r = 1; r <= 9; r++) c->counts[r] = 4 * ndecks;
+    c->counts[10] = 16 * ndecks;
+    c->total = DECK_SIZE * ndecks;
+}
+
+int ev_comp_remove(EvComp *c, Card card) {
+    int r = points(card);
+    if (r < 1 || c->counts[r] == 0) return -1;
+    c->counts[r]--;
+    c->total--;
+    return 0;
+}
+
+/* Six bits per small rank, eight for the tens: 8 decks fit in 62 bits */
+static uint64_t pack(const EvComp *c) {
+    uint64_t k = 0;
+    for (int r = 1; r <= 9; r++) k |= (uint64_t)c->counts[r] << (6 * (r - 1));
+    return k | (uint64_t)c->counts[10] << 54;
+}
+
+/* ---------- memo tables ---------- */
+
+static int map_init(EvMap *m, int nvals) {
+    m->cap = MAP_INITIAL;
+    m->used = 0;
+    m->nvals = nvals;
+    m->comps = malloc(m->cap * sizeof(*m->comps));
+    m->states = calloc(m->cap, sizeof(*m->states));
+    m->vals = malloc(m->cap * (size_t)nvals * sizeof(*m->vals));
+    return (m->comps && m->states && m->vals) ? 0 : -1;
+}
+
+static void map_free(EvMap *m) {
+    free(m->comps);
+    free(m->states);
+    free(m->vals);
+    memset(m, 0, sizeof(*m));
+}
+
+static size_t slot_of(const EvMap *m, uint64_t comp, uint32_t state) {
+    uint64_t x = comp ^ ((uint64_t)state * 0x9e3779b97f4a7c15ULL);
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 29;
+    return (size_t)x & (m->cap - 1);
+}
+
+static double *map_find(EvMap *m, uint64_t comp, uint32_t state) {
+    for (size_t i = slot_of(m, comp, state);; i = (i + 1) & (m->cap - 1)) {
+        if (m->states[i] == 0) return NULL;
+        if (m->states[i] == state && m->comps[i] == comp) return m->vals + i * (size_t)m->nvals;
+    }
+}
+
+static int map_grow(EvMap *m) {
+    EvMap big;
+    big.cap = m->cap * 2;
+    big.used = m->used;
+    big.nvals = m->nvals;
+    big.comps = malloc(big.cap * sizeof(*big.comps));
+    big.states = calloc(big.cap, sizeof(*big.states));
+    big.vals = malloc(big.cap * (size_t)big.nvals * sizeof(*big.vals));
+    if (!big.comps || !big.states || !big.vals) {
+        map_free(&big);
+        return -1;
+    }
+
+    size_t vsize = (size_t)m->nvals * sizeof(*m->vals);
+    for (size_t i = 0; i < m->cap; i++) {
+        if (m->states[i] == 0) continue;
+        size_t j = slot_of(&big, m->comps[i], m->states[i]);
+        while (big.states[j]) j = (j + 1) & (big.cap - 1);
+        big.comps[j] = m->comps[i];
+        big.states[j] = m->states[i];
+        memcpy(big.vals + j * (size_t)big.nvals, m->vals + i * (size_t)m->nvals, vsize);
+    }
+    map_free(m);
+    *m = big;
+    return 0;
+}
+
+/* Room for a new entry's values, or NULL when memory runs out (the caller
+ * then just doesn't remember the result) */
+static double *map_insert(EvMap *m, uint64_t comp, uint32_t state) {
+    if (2 * (m->used + 1) > m->cap && map_grow(m) < 0) return NULL;
+    size_t i = slot_of(m, comp, state);
+    while (m->states[i]) i = (i + 1) & (m->cap - 1);
+    m->comps[i] = comp;
+    m->states[i] = state;
+    m->used++;
+    return m->vals + i * (size_t)m->nvals;
+}
+
+int ev_init(EvCtx *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (map_init(&ctx->dealer, DEALER_OUTCOMES) < 0 || map_init(&ctx->player, 1) < 0) {
+        ev_free(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+void ev_free(EvCtx *ctx) {
+    map_free(&ctx->dealer);
+    map_free(&ctx->player);
+}
+
+/* ---------- dealer ---------- */
+
+/* hand_value() of any hand with this hard total and ace count */
+static int value_of(int hard, int aces) {
+    Hand h;
+    hand_init(&h);
+    h.hard = (uint8_t)hard;
+    h.aces = (uint8_t)aces;
+    return hand_value(&h);
+}
+
+/* Hand states are (hard total, holds an ace), never 0 */
+static uint32_t hand_state(int hard, int aces) {
+    return 1u + (uint32_t)hard + (aces ? 64u : 0u);
+}
+
+static void dealer_walk(EvCtx *ctx, EvComp *c, int hard, int aces, double *odds) {
+    memset(odds, 0, DEALER_OUTCOMES * sizeof(*odds));
+    int v = value_of(hard, aces);
+    if (v >= 17) {
+        odds[v > 21 ? DEALER_BUST : DEALER_17 + (v - 17)] = 1.0;
+        return;
+    }
+    // an exhausted composition drops the branch; no full deck gets this far
+    if (c->total == 0) return;
+
+    uint64_t key = pack(c);
+    uint32_t state = hand_state(hard, aces);
+    const double *memo = map_find(&ctx->dealer, key, state);
+    if (memo) {
+        memcpy(odds, memo, DEALER_OUTCOMES * sizeof(*odds));
+        return;
+    }
+
+    double sub[DEALER_OUTCOMES];
+    int total = c->total;
+    for (int r = 1; r <= EV_RANKS; r++) {
+        int n = c->counts[r];
+        if (n == 0) continue;
+        double p = (double)n / total;
+        c->counts[r]--;
+        c->total--;
+        dealer_walk(ctx, c, hard + r, aces + (r == 1), sub);
+        c->counts[r]++;
+        c->total++;
+        for (int o = 0; o < DEALER_OUTCOMES; o++) odds[o] += p * sub[o];
+    }
+
+    double *slot = map_insert(&ctx->dealer, key, state);
+    if (slot) memcpy(slot, odds, DEALER_OUTCOMES * sizeof(*odds));
+}
+
+void ev_dealer_odds(EvCtx *ctx, const EvComp *c, Card up, double *odds) {
+    EvComp work = *c;
+    int r = points(up);
+    dealer_walk(ctx, &work, r, r == 1, odds);
+}
+
+/* ---------- player ---------- */
+
+/* The table pays 1:1 on every win and pushes ties */
+static double stand_ev(int v, const double *odds) {
+    double ev = odds[DEALER_BUST];
+    for (int o = DEALER_17; o <= DEALER_21; o++) {
+        int dv = 17 + o;
+        if (v > dv) ev += odds[o];
+        else if (v < dv) ev -= odds[o];
+    }
+    return ev;
+}
+
+static double best_ev(EvCtx *ctx, EvComp *c, int hard, int aces, int up);
+
+/* Stand and hit EVs; *can_hit is 0 on 21, where the table stands for you */
+static void solve(EvCtx *ctx, EvComp *c, int hard, int aces, int up,
+                  double *stand, double *hit, int *can_hit) {
+    double odds[DEALER_OUTCOMES];
+    int v = value_of(hard, aces);
+    dealer_walk(ctx, c, up, up == 1, odds);
+    *stand = stand_ev(v, odds);
+    *hit = 0.0;
+    *can_hit = v < 21 && c->total > 0;
+    if (!*can_hit) return;
+
+    int total = c->total;
+    for (int r = 1; r <= EV_RANKS; r++) {
+        int n = c->counts[r];
+        if (n == 0) continue;
+        double p = (double)n / total;
+        int nh = hard + r, na = aces + (r == 1);
+        if (value_of(nh, na) > 21) {
+            *hit -= p;
+            continue;
+        }
+        c->counts[r]--;
+        c->total--;
+        *hit += p * best_ev(ctx, c, nh, na, up);
+        c->counts[r]++;
+        c->total++;
+    }
+}
+
+static double best_ev(EvCtx *ctx, EvComp *c, int hard, int aces, int up) {
+    uint64_t key = pack(c);
+    uint32_t state = hand_state(hard, aces) | (uint32_t)up << 8;
+    const double *memo = map_find(&ctx->player, key, state);
+    if (memo) return *memo;
+
+    double stand, hit;
+    int can_hit;
+    solve(ctx, c, hard, aces, up, &stand, &hit, &can_hit);
+    double best = (can_hit && hit > stand) ? hit : stand;
+
+    double *slot = map_insert(&ctx->player, key, state);
+    if (slot) *slot = best;
+    return best;
+}
+
+int ev_hand(EvCtx *ctx, const EvComp *c, const Hand *player, Card up, EvResult *out) {
+    EvComp work = *c;
+    int can_hit;
+    solve(ctx, &work, player->hard, player->aces, points(up), &out->stand, &out->hit, &can_hit);
+    if (!can_hit) out->hit = out->stand;
+    return can_hit;
+}
+
+/* ---------- whole-round analysis ---------- */
+
+typedef struct {
+    const EvComp *comp;
+    EvAnalysis *out;
+    int next;                 /* next deal to solve, shared */
+    int failed;
+} Job;
+
+static void *analyze_main(void *arg) {
+    Job *job = arg;
+    EvCtx ctx;
+    if (ev_init(&ctx) < 0) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    int i;
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->out->ndeals) {
+        EvDeal *d = &job->out->deals[i];
+        EvComp c = *job->comp;
+        c.counts[d->a]--;
+        c.counts[d->b]--;
+        c.counts[d->up]--;
+        c.total -= 3;
+
+        int can_hit;
+        solve(&ctx, &c, d->a + d->b, (d->a == 1) + (d->b == 1), d->up,
+              &d->ev.stand, &d->ev.hit, &can_hit);
+        if (!can_hit) d->ev.hit = d->ev.stand;
+    }
+    ev_free(&ctx);
+    return NULL;
+}
+
+/* Chance of drawing ranks x, y, z in that order from c */
+static double draw3(const EvComp *c, int x, int y, int z) {
+    EvComp w = *c;
+    double p = 1.0;
+    int seq[3] = { x, y, z };
+    for (int k = 0; k < 3; k++) {
+        if (w.counts[seq[k]] == 0) return 0.0;
+        p *= (double)w.counts[seq[k]] / w.total;
+        w.counts[seq[k]]--;
+        w.total--;
+    }
+    return p;
+}
+
+int ev_analyze(const EvComp *c, int nthreads, EvAnalysis *out) {
+    out->ndeals = 0;
+    for (int up = 1; up <= EV_RANKS; up++) {
+        for (int a = 1; a <= EV_RANKS; a++) {
+            for (int b = a; b <= EV_RANKS; b++) {
+                // player, dealer, player, as the table deals
+                double p = draw3(c, a, up, b);
+                if (a != b) p += draw3(c, b, up, a);
+                if (p == 0.0) continue;
+                EvDeal *d = &out->deals[out->ndeals++];
+                d->a = a;
+                d->b = b;
+                d->up = up;
+                d->prob = p;
+            }
+        }
+    }
+
+    if (nthreads < 1) nthreads = 1;
+    pthread_t *tids = calloc((size_t)nthreads, sizeof(*tids));
+    if (!tids) {
+        perror("calloc");
+        return -1;
+    }
+    Job job = { c, out, 0, 0 };
+    int started = 0;
+    for (; started < nthreads; started++) {
+        if (pthread_create(&tids[started], NULL, analyze_main, &job) != 0) {
+            perror("pthread_create");
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    free(tids);
+    if (started == 0 || job.failed) return -1;
+
+    out->ev = 0.0;
+    for (int i = 0; i < out->ndeals; i++) {
+        const EvDeal *d = &out->deals[i];
+        out->ev += d->prob * (d->ev.hit > d->ev.stand ? d->ev.hit : d->ev.stand);
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Synthetic round journal, for checking ./replay without a server.
+ *
+ * Usage: ./gen_journal <path> [--tables N] [--rounds N] [--seed S]
+ *
+ * Deals --rounds rounds (default 20) at each of --tables tables (default
+ * 100), each table from its own seed, and writes them interleaved as a
+ * server's shards would: every seat draws to 17, now and then one times
+ * out or leaves mid-round. The file is replaced, not appended to.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/journal.h"
+#include "../include/proto.h"
+
+#define SEATS 5
+
+typedef struct {
+    Shoe shoe;
+    uint64_t seed;
+    uint32_t rounds;
+} GenTable;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <path> [--tables N] [--rounds N] [--seed S]\n", prog);
+}
+
+/* One round at t, through the engine, closed with its results into buf */
+static size_t deal_round(GenTable *t, int id, Rng *rng, char *buf) {
+    Hand seats[SEATS], dealer;
+    JournalRound r;
+    unsigned dealt = 1u + rng_bounded(rng, (1u << SEATS) - 1);
+
+    shoe_begin_round(&t->shoe);
+    journal_round_begin(&r, id, t->rounds++, t->seed, &t->shoe, dealt);
+    for (unsigned m = dealt; m; m &= m - 1) hand_init(&seats[__builtin_ctz(m)]);
+    hand_init(&dealer);
+    for (int k = 0; k < 2; k++) {
+        for (unsigned m = dealt; m; m &= m - 1) {
+            Card c = shoe_deal(&t->shoe);
+            journal_card(&r, c);
+            hand_add_card(&seats[__builtin_ctz(m)], c);
+        }
+        Card c = shoe_deal(&t->shoe);
+        journal_card(&r, c);
+        hand_add_card(&dealer, c);
+    }
+
+    for (unsigned m = dealt; m; m &= m - 1) {
+        int i = __builtin_ctz(m);
+        if (hand_is_blackjack(&seats[i])) continue;
+        uint32_t roll = rng_bounded(rng, 20);
+        if (roll == 0) {
+            journal_action(&r, i, JOURNAL_ACT_LEFT);
+            continue;
+        }
+        while (hand_value(&seats[i]) < 17) {
+            Card c = shoe_deal(&t->shoe);
+            journal_action(&r, i, JOURNAL_ACT_HIT);
+            journal_card(&r, c);
+            hand_add_card(&seats[i], c);
+        }
+        if (hand_value(&seats[i]) < 21)
+            journal_action(&r, i, roll == 1 ? JOURNAL_ACT_TIMEOUT : JOURNAL_ACT_STAND);
+    }
+
+    play_dealer_hand(&dealer, &t->shoe);
+    for (int k = 2; k < dealer.count; k++) journal_card(&r, dealer.cards[k]);
+
+    uint8_t results[JOURNAL_MAX_SEATS];
+    int n = 0;
+    for (unsigned m = dealt; m; m &= m - 1) {
+        int i = __builtin_ctz(m);
+        int outcome = hand_outcome(&seats[i], &dealer);
+        results[n++] = (r.gone & (1u << i)) ? JOURNAL_RES_GONE
+                     : outcome > 0 ? RESULT_WIN : outcome < 0 ? RESULT_LOSE : RESULT_PUSH;
+    }
+    return journal_round_encode(&r, results, buf);
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    int ntables = 100, nrounds = 20;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tables") == 0 && i + 1 < argc) {
+            ntables = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            nrounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path || ntables < 1 || nrounds < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    GenTable *tables = calloc((size_t)ntables, sizeof(*tables));
+    if (!tables) {
+        perror("calloc");
+        return 1;
+    }
+    Rng rng;
+    rng_seed(&rng, RNG_DEFAULT, seed);
+    for (int i = 0; i < ntables; i++) {
+        tables[i].seed = rng_next64(&rng);
+        shoe_init_seeded(&tables[i].shoe, SHOE_DEFAULT_DECKS, SHOE_DEFAULT_PENETRATION,
+                         tables[i].seed);
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        free(tables);
+        return 1;
+    }
+    JournalHeader h = { JOURNAL_MAGIC, JOURNAL_VERSION };
+    fwrite(&h, sizeof(h), 1, f);
+
+    // round by round across the tables, so every table's shoe is revisited
+    char buf[JOURNAL_MAX_RECORD];
+    for (int k = 0; k < nrounds; k++) {
+        for (int i = 0; i < ntables; i++) {
+            size_t len = deal_round(&tables[i], i + 1, &rng, buf);
+            fwrite(buf, len, 1, f);
+        }
+    }
+    free(tables);
+    if (fclose(f) != 0) {
+        perror(path);
+        return 1;
+    }
+    printf("%d tables, %d rounds each, written to %s\n", ntables, nrounds, path);
+    return 0;
+}
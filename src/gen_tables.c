@@ -0,0 +1,149 @@
+/*
+ * Build-time generator for strategy.c's lookup tables.
+ *
+ * Usage: ./gen_tables > strategy_tables.h
+ *
+ * Works on an infinite shoe (every rank 1/13, tens 4/13) and plays the
+ * hands through blackjack.c itself, so the dealer rule and hand values are
+ * exactly the engine's:
+ *   dealer_odds[up][outcome]  - where play_dealer_hand() ends from each up card
+ *   hint[soft][total][up]     - hit or stand, whichever has the higher EV
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/blackjack.h"
+#include "../include/strategy.h"
+
+#define RANKS 10    /* ace..nine, then every ten-valued card as rank 10 */
+
+static double rank_prob(int rank) {
+    return rank == 10 ? 4.0 / 13.0 : 1.0 / 13.0;
+}
+
+/* ---------- dealer ---------- */
+
+/* Add each way this partial dealer hand finishes, weighted by p */
+static void dealer_walk(const Hand *h, double p, double *odds) {
+    int v = hand_value(h);
+    if (v >= 17) {
+        odds[v > 21 ? DEALER_BUST : DEALER_17 + (v - 17)] += p;
+        return;
+    }
+    for (int r = 1; r <= RANKS; r++) {
+        Hand next = *h;
+        hand_add_card(&next, card_make(r, 0));
+        dealer_walk(&next, p * rank_prob(r), odds);
+    }
+}
+
+/* ---------- player ---------- */
+
+static double dealer_odds[RANKS + 1][DEALER_OUTCOMES];
+
+/* EV of standing on v: the engine pays 1:1 and pushes ties */
+static double stand_ev(int v, int up) {
+    const double *d = dealer_odds[up];
+    double ev = d[DEALER_BUST];
+    for (int o = DEALER_17; o <= DEALER_21; o++) {
+        int dv = 17 + o;
+        if (v > dv) ev += d[o];
+        else if (v < dv) ev -= d[o];
+    }
+    return ev;
+}
+
+/* A few-card hand with this (soft, value), so hitting it never meets the
+ * MAX_HAND_CARDS limit the way a long run of small cards could */
+static void canonical_hand(Hand *h, int soft, int v) {
+    hand_init(h);
+    if (soft) {
+        hand_add_card(h, card_make(1, 0));
+        hand_add_card(h, card_make(v - 11, 0));
+        return;
+    }
+    while (v > 10) {
+        int c = v - 10 >= 2 ? 10 : 9;   // never leave a lone ace-sized 1
+        hand_add_card(h, card_make(c, 0));
+        v -= c;
+    }
+    hand_add_card(h, card_make(v, 0));
+}
+
+/* Best EV by (soft, value); hands with the same pair play the same */
+static double memo[2][22];
+static int known[2][22];
+static unsigned char hint[2][22][RANKS + 1];
+
+static double best_ev(const Hand *h, int up) {
+    int v = hand_value(h);
+    if (v > 21) return -1.0;
+    int soft = hand_is_soft(h);
+    if (known[soft][v]) return memo[soft][v];
+
+    Hand base;
+    canonical_hand(&base, soft, v);
+
+    double stand = stand_ev(v, up);
+    double hit = 0.0;
+    for (int r = 1; r <= RANKS; r++) {
+        Hand next = base;
+        hand_add_card(&next, card_make(r, 0));
+        hit += rank_prob(r) * best_ev(&next, up);
+    }
+
+    // the table stands the player automatically on 21
+    int take = v < 21 && hit > stand;
+    hint[soft][v][up] = (unsigned char)(take ? HINT_HIT : HINT_STAND);
+    memo[soft][v] = take ? hit : stand;
+    known[soft][v] = 1;
+    return memo[soft][v];
+}
+
+int main(void) {
+    for (int up = 1; up <= RANKS; up++) {
+        Hand h;
+        hand_init(&h);
+        hand_add_card(&h, card_make(up, 0));
+        dealer_walk(&h, 1.0, dealer_odds[up]);
+    }
+
+    for (int up = 1; up <= RANKS; up++) {
+        memset(known, 0, sizeof(known));
+        // reach every (soft, total) a player can be asked about
+        for (int a = 1; a <= RANKS; a++) {
+            for (int b = 1; b <= RANKS; b++) {
+                Hand h;
+                hand_init(&h);
+                hand_add_card(&h, card_make(a, 0));
+                hand_add_card(&h, card_make(b, 0));
+                best_ev(&h, up);
+            }
+        }
+    }
+
+    printf("/* Generated by gen_tables; do not edit */\n\n");
+    printf("static const double dealer_odds[%d][%d] = {\n", RANKS + 1, DEALER_OUTCOMES);
+    for (int up = 0; up <= RANKS; up++) {
+        printf("    {");
+        for (int o = 0; o < DEALER_OUTCOMES; o++)
+            printf(" %.17g%s", dealer_odds[up][o], o + 1 < DEALER_OUTCOMES ? "," : " ");
+        printf("},\n");
+    }
+    printf("};\n\n");
+
+    printf("static const unsigned char hint_table[2][22][%d] = {\n", RANKS + 1);
+    for (int soft = 0; soft < 2; soft++) {
+        printf("    {\n");
+        for (int v = 0; v < 22; v++) {
+            printf("        {");
+            for (int up = 0; up <= RANKS; up++)
+                printf(" %d%s", hint[soft][v][up], up < RANKS ? "," : " ");
+            printf("},\n");
+        }
+        printf("    },\n");
+    }
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "../include/handbatch.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+void hand_batch_clear(HandBatch *b) {
+    memset(b->count, 0, b->n);
+    memset(b->hard, 0, b->n);
+    memset(b->aces, 0, b->n);
+}
+
+void hand_batch_load(HandBatch *b, const Hand *hands) {
+    for (size_t i = 0; i < b->n; i++) {
+        b->count[i] = hands[i].count;
+        b->hard[i] = hands[i].hard;
+        b->aces[i] = hands[i].aces;
+    }
+}
+
+/* ---------- scalar ---------- */
+
+/* The same arithmetic as blackjack.c, one lane at a time; the vector
+ * kernels also use it for the lanes left over after the last full vector. */
+
+static void add_scalar(HandBatch *b, const Card *cards, size_t from) {
+    for (size_t i = from; i < b->n; i++) {
+        if (b->count[i] >= MAX_HAND_CARDS) continue;
+        int r = card_rank(cards[i]);
+        b->count[i]++;
+        b->hard[i] += r > 13 ? 0 : (r > 10 ? 10 : r);
+        b->aces[i] += r == 1;
+    }
+}
+
+static void eval_scalar(const HandBatch *b, HandBatchEval *out, size_t from) {
+    for (size_t i = from; i < b->n; i++) {
+        int soft = b->aces[i] > 0 && b->hard[i] + 10 <= 21;
+        int value = soft ? b->hard[i] + 10 : b->hard[i];
+        out->value[i] = (uint8_t)value;
+        out->soft[i] = (uint8_t)soft;
+        out->bust[i] = value > 21;
+        out->blackjack[i] = b->count[i] == 2 && value == 21;
+    }
+}
+
+static void add_plain(HandBatch *b, const Card *cards) { add_scalar(b, cards, 0); }
+static void eval_plain(const HandBatch *b, HandBatchEval *out) { eval_scalar(b, out, 0); }
+
+#ifdef HAVE_X86
+
+/* ---------- SSE2, 16 lanes ---------- */
+
+/* Every comparison is unsigned (x <= k  <=>  min(x, k) == x), so lanes
+ * holding out-of-range bytes still match the scalar path. */
+
+static void add_sse2(HandBatch *b, const Card *cards) {
+    const __m128i lowbits = _mm_set1_epi8(0x3f);
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 16 <= b->n; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(cards + i));
+        __m128i count = _mm_loadu_si128((const __m128i *)(b->count + i));
+        __m128i hard = _mm_loadu_si128((const __m128i *)(b->hard + i));
+        __m128i aces = _mm_loadu_si128((const __m128i *)(b->aces + i));
+
+        __m128i rank = _mm_and_si128(_mm_srli_epi16(c, 2), lowbits);
+        __m128i room = _mm_cmpeq_epi8(_mm_min_epu8(count, _mm_set1_epi8(MAX_HAND_CARDS - 1)), count);
+        __m128i valid = _mm_cmpeq_epi8(_mm_min_epu8(rank, _mm_set1_epi8(13)), rank);
+        __m128i points = _mm_and_si128(_mm_min_epu8(rank, _mm_set1_epi8(10)), valid);
+        __m128i ace = _mm_and_si128(_mm_cmpeq_epi8(rank, one), one);
+
+        count = _mm_add_epi8(count, _mm_and_si128(room, one));
+        hard = _mm_add_epi8(hard, _mm_and_si128(room, points));
+        aces = _mm_add_epi8(aces, _mm_and_si128(room, ace));
+
+        _mm_storeu_si128((__m128i *)(b->count + i), count);
+        _mm_storeu_si128((__m128i *)(b->hard + i), hard);
+        _mm_storeu_si128((__m128i *)(b->aces + i), aces);
+    }
+    add_scalar(b, cards, i);
+}
+
+static void eval_sse2(const HandBatch *b, HandBatchEval *out) {
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 16 <= b->n; i += 16) {
+        __m128i count = _mm_loadu_si128((const __m128i *)(b->count + i));
+        __m128i hard = _mm_loadu_si128((const __m128i *)(b->hard + i));
+        __m128i aces = _mm_loadu_si128((const __m128i *)(b->aces + i));
+
+        __m128i no_aces = _mm_cmpeq_epi8(aces, _mm_setzero_si128());
+        __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(hard, _mm_set1_epi8(11)), hard);
+        __m128i soft = _mm_andnot_si128(no_aces, low);
+        __m128i value = _mm_add_epi8(hard, _mm_and_si128(soft, _mm_set1_epi8(10)));
+        __m128i bust = _mm_cmpeq_epi8(_mm_max_epu8(value, _mm_set1_epi8(22)), value);
+        __m128i bj = _mm_and_si128(_mm_cmpeq_epi8(count, _mm_set1_epi8(2)),
+                                   _mm_cmpeq_epi8(value, _mm_set1_epi8(21)));
+
+        _mm_storeu_si128((__m128i *)(out->value + i), value);
+        _mm_storeu_si128((__m128i *)(out->soft + i), _mm_and_si128(soft, one));
+        _mm_storeu_si128((__m128i *)(out->bust + i), _mm_and_si128(bust, one));
+        _mm_storeu_si128((__m128i *)(out->blackjack + i), _mm_and_si128(bj, one));
+    }
+    eval_scalar(b, out, i);
+}
+
+/* ---------- AVX2, 32 lanes ---------- */
+
+__attribute__((target("avx2")))
+static void add_avx2(HandBatch *b, const Card *cards) {
+    const __m256i lowbits = _mm256_set1_epi8(0x3f);
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 32 <= b->n; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(cards + i));
+        __m256i count = _mm256_loadu_si256((const __m256i *)(b->count + i));
+        __m256i hard = _mm256_loadu_si256((const __m256i *)(b->hard + i));
+        __m256i aces = _mm256_loadu_si256((const __m256i *)(b->aces + i));
+
+        __m256i rank = _mm256_and_si256(_mm256_srli_epi16(c, 2), lowbits);
+        __m256i room = _mm256_cmpeq_epi8(_mm256_min_epu8(count, _mm256_set1_epi8(MAX_HAND_CARDS - 1)), count);
+        __m256i valid = _mm256_cmpeq_epi8(_mm256_min_epu8(rank, _mm256_set1_epi8(13)), rank);
+        __m256i points = _mm256_and_si256(_mm256_min_epu8(rank, _mm256_set1_epi8(10)), valid);
+        __m256i ace = _mm256_and_si256(_mm256_cmpeq_epi8(rank, one), one);
+
+        count = _mm256_add_epi8(count, _mm256_and_si256(room, one));
+        hard = _mm256_add_epi8(hard, _mm256_and_si256(room, points));
+        aces = _mm256_add_epi8(aces, _mm256_and_si256(room, ace));
+
+        _mm256_storeu_si256((__m256i *)(b->count + i), count);
+        _mm256_storeu_si256((__m256i *)(b->hard + i), hard);
+        _mm256_storeu_si256((__m256i *)(b->aces + i), aces);
+    }
+    add_scalar(b, cards, i);
+}
+
+__attribute__((target("avx2")))
+static void eval_avx2(const HandBatch *b, HandBatchEval *out) {
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 32 <= b->n; i += 32) {
+        __m256i count = _mm256_loadu_si256((const __m256i *)(b->count + i));
+        __m256i hard = _mm256_loadu_si256((const __m256i *)(b->hard + i));
+        __m256i aces = _mm256_loadu_si256((const __m256i *)(b->aces + i));
+
+        __m256i no_aces = _mm256_cmpeq_epi8(aces, _mm256_setzero_si256());
+        __m256i low = _mm256_cmpeq_epi8(_mm256_min_epu8(hard, _mm256_set1_epi8(11)), hard);
+        __m256i soft = _mm256_andnot_si256(no_aces, low);
+        __m256i value = _mm256_add_epi8(hard, _mm256_and_si256(soft, _mm256_set1_epi8(10)));
+        __m256i bust = _mm256_cmpeq_epi8(_mm256_max_epu8(value, _mm256_set1_epi8(22)), value);
+        __m256i bj = _mm256_and_si256(_mm256_cmpeq_epi8(count, _mm256_set1_epi8(2)),
+                                      _mm256_cmpeq_epi8(value, _mm256_set1_epi8(21)));
+
+        _mm256_storeu_si256((__m256i *)(out->value + i), value);
+        _mm256_storeu_si256((__m256i *)(out->soft + i), _mm256_and_si256(soft, one));
+        _mm256_storeu_si256((__m256i *)(out->bust + i), _mm256_and_si256(bust, one));
+        _mm256_storeu_si256((__m256i *)(out->blackjack + i), _mm256_and_si256(bj, one));
+    }
+    eval_scalar(b, out, i);
+}
+
+#endif /* HAVE_X86 */
+
+/* ---------- dispatch ---------- */
+
+typedef struct {
+    const char *name;
+    void (*add)(HandBatch *, const Card *);
+    void (*eval)(const HandBatch *, HandBatchEval *);
+} Kernel;
+
+static const Kernel plain = { "scalar", add_plain, eval_plain };
+#ifdef HAVE_X86
+static const Kernel sse2 = { "sse2", add_sse2, eval_sse2 };
+static const Kernel avx2 = { "avx2", add_avx2, eval_avx2 };
+#endif
+
+/* Resolved on first use; racing threads all store the same pointer */
+static const Kernel *kernel;
+
+static const Kernel *pick(void) {
+    const Kernel *k = __atomic_load_n(&kernel, __ATOMIC_RELAXED);
+    if (k) return k;
+    k = &plain;
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) k = &avx2;
+    else if (__builtin_cpu_supports("sse2")) k = &sse2;
+#endif
+    __atomic_store_n(&kernel, k, __ATOMIC_RELAXED);
+    return k;
+}
+
+void hand_batch_add(HandBatch *b, const Card *cards) {
+    pick()->add(b, cards);
+}
+
+void hand_batch_eval(const HandBatch *b, HandBatchEval *out) {
+    pick()->eval(b, out);
+}
+
+const char *hand_batch_kernel(void) {
+    return pick()->name;
+}
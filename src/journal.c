@@ -0,0 +1,231 @@
+#include "../include/journal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* ---------- building a record ---------- */
+
+void journal_round_begin(JournalRound *r, int table, uint32_t round, uint64_t seed,
+                         const Shoe *shoe, unsigned seats) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    memset(&r->rec, 0, sizeof(r->rec));
+    r->rec.ndecks = (uint8_t)shoe->ndecks;
+    r->rec.seats = (uint8_t)seats;
+    r->rec.top = (uint16_t)shoe->top;
+    r->rec.table = (uint32_t)table;
+    r->rec.round = round;
+    r->rec.seed = seed;
+    r->rec.shuffles = shoe->shuffles;
+    r->rec.time_ms = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    r->gone = 0;
+    r->open = 1;
+}
+
+size_t journal_round_encode(JournalRound *r, const uint8_t *results, char *buf) {
+    int nresults = __builtin_popcount(r->rec.seats);
+    size_t len = sizeof(r->rec) + r->rec.ncards + r->rec.nactions + (size_t)nresults;
+    r->rec.len = (uint16_t)len;
+    r->open = 0;
+
+    char *p = buf;
+    memcpy(p, &r->rec, sizeof(r->rec));
+    p += sizeof(r->rec);
+    memcpy(p, r->cards, r->rec.ncards);
+    p += r->rec.ncards;
+    memcpy(p, r->actions, r->rec.nactions);
+    p += r->rec.nactions;
+    memcpy(p, results, (size_t)nresults);
+    return len;
+}
+
+int journal_round_end(Journal *j, JournalRound *r, const uint8_t *results) {
+    char buf[JOURNAL_MAX_RECORD];
+    size_t len = journal_round_encode(r, results, buf);
+
+    int waited = 0;
+    pthread_mutex_lock(&j->lock);
+    while (j->fill_len + len > JOURNAL_BUF_SIZE) {
+        // the disk is behind by a whole buffer: the one place a table waits
+        waited = 1;
+        pthread_cond_wait(&j->room, &j->lock);
+    }
+    memcpy(j->fill + j->fill_len, buf, len);
+    j->fill_len += len;
+    // the writer sleeps on an empty buffer, or out its window until half full
+    if (j->fill_len == len || (j->fill_len >= JOURNAL_BUF_SIZE / 2 &&
+                               j->fill_len - len < JOURNAL_BUF_SIZE / 2))
+        pthread_cond_signal(&j->work);
+    pthread_mutex_unlock(&j->lock);
+    return waited;
+}
+
+/* ---------- reading ---------- */
+
+int journal_check_header(const char *buf, size_t len) {
+    JournalHeader h;
+    if (len < sizeof(h)) return -1;
+    memcpy(&h, buf, sizeof(h));
+    return h.magic == JOURNAL_MAGIC && h.version == JOURNAL_VERSION ? 0 : -1;
+}
+
+int journal_next(const char *buf, size_t len, size_t *off, JournalEntry *e) {
+    if (*off == len) return 0;
+    if (len - *off < sizeof(e->rec)) return -1;
+    memcpy(&e->rec, buf + *off, sizeof(e->rec));
+
+    size_t want = sizeof(e->rec) + e->rec.ncards + e->rec.nactions +
+                  (size_t)__builtin_popcount(e->rec.seats);
+    if (e->rec.len != want || len - *off < want) return -1;
+    const uint8_t *p = (const uint8_t *)buf + *off + sizeof(e->rec);
+    e->cards = p;
+    e->actions = p + e->rec.ncards;
+    e->results = e->actions + e->rec.nactions;
+    *off += want;
+    return 1;
+}
+
+/* ---------- writing ---------- */
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* Until sync_ms after the last commit began, or the buffer is half full:
+ * everything appended meanwhile joins the same write and fdatasync */
+static void wait_window(Journal *j, uint64_t last) {
+    uint64_t until = last + (uint64_t)j->sync_ms;
+    struct timespec ts = { (time_t)(until / 1000), (long)(until % 1000) * 1000000 };
+    while (j->fill_len < JOURNAL_BUF_SIZE / 2 && now_ms() < until)
+        pthread_cond_timedwait(&j->work, &j->lock, &ts);
+}
+
+static void *writer_main(void *arg) {
+    Journal *j = arg;
+    uint64_t last = 0;
+    pthread_mutex_lock(&j->lock);
+    while (1) {
+        while (j->fill_len == 0) pthread_cond_wait(&j->work, &j->lock);
+        wait_window(j, last);
+
+        char *batch = j->fill;
+        size_t len = j->fill_len;
+        j->fill = batch == j->bufs[0] ? j->bufs[1] : j->bufs[0];
+        j->fill_len = 0;
+        pthread_cond_broadcast(&j->room);
+        pthread_mutex_unlock(&j->lock);
+
+        last = now_ms();
+        if (write_all(j->fd, batch, len) < 0) perror("journal write");
+        else if (fdatasync(j->fd) < 0) perror("journal fdatasync");
+
+        pthread_mutex_lock(&j->lock);
+    }
+    return NULL;
+}
+
+/* A new file gets its header; an old one is checked and cut back to its
+ * last whole record, which a crash mid-write may have left behind */
+static int prepare_file(int fd, const char *path) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("journal fstat");
+        return -1;
+    }
+    if (st.st_size == 0) {
+        JournalHeader h = { JOURNAL_MAGIC, JOURNAL_VERSION };
+        if (write_all(fd, (const char *)&h, sizeof(h)) < 0 || fdatasync(fd) < 0) {
+            perror("journal header");
+            return -1;
+        }
+        return 0;
+    }
+
+    size_t len = (size_t)st.st_size;
+    char *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("journal mmap");
+        return -1;
+    }
+    if (journal_check_header(map, len) < 0) {
+        fprintf(stderr, "%s is not a round journal (or a different version)\n", path);
+        munmap(map, len);
+        return -1;
+    }
+    size_t off = sizeof(JournalHeader);
+    JournalEntry e;
+    while (journal_next(map, len, &off, &e) > 0) {}
+    munmap(map, len);
+
+    if (off < len) {
+        fprintf(stderr, "%s: cut %zu bytes of torn record at offset %zu\n", path, len - off, off);
+        if (ftruncate(fd, (off_t)off) < 0) {
+            perror("journal ftruncate");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int journal_open(Journal *j, const char *path, int sync_ms) {
+    memset(j, 0, sizeof(*j));
+    j->sync_ms = sync_ms < 0 ? 0 : sync_ms;
+    j->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (j->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (prepare_file(j->fd, path) < 0) {
+        close(j->fd);
+        return -1;
+    }
+
+    j->bufs[0] = malloc(JOURNAL_BUF_SIZE);
+    j->bufs[1] = malloc(JOURNAL_BUF_SIZE);
+    if (!j->bufs[0] || !j->bufs[1]) {
+        perror("malloc");
+        free(j->bufs[0]);
+        free(j->bufs[1]);
+        close(j->fd);
+        return -1;
+    }
+    j->fill = j->bufs[0];
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_cond_init(&j->work, &ca);
+    pthread_cond_init(&j->room, NULL);
+    pthread_condattr_destroy(&ca);
+
+    int rc = pthread_create(&j->thread, NULL, writer_main, j);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+        return -1;
+    }
+    pthread_detach(j->thread);
+    return 0;
+}
@@ -0,0 +1,489 @@
+/*
+ * Load generator
+ * Opens many bot connections from one epoll loop and has each play every
+ * round automatically, then reports throughput and decision latency.
+ *
+ * Usage: ./loadgen <server-ip> <port> [--bots N] [--duration SEC]
+ *                  [--strategy NAME] [--binary] [--connect-burst N]
+ *        ./loadgen --shm <path> [options as above]
+ *
+ * With --shm the bots connect to the server's --shm-socket and play through
+ * shared memory (see shm.h) rather than TCP.
+ *
+ * Latency is measured from sending a decision (HIT, STAND or HINT) to the
+ * first byte of the server's answer. Connections are opened at most
+ * --connect-burst at a time (default 128, the smallest somaxconn kernels ship
+ * with): the server's listen queue is SOMAXCONN unless its --backlog says
+ * otherwise, and a SYN it drops costs a full second of retransmit.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../include/proto.h"
+#include "../include/rxbuf.h"
+#include "../include/shm.h"
+#include "../include/strategy.h"
+
+#define MAX_EVENTS 256
+
+typedef enum {
+    BOT_CONNECTING,
+    BOT_PLAYING,
+    BOT_CLOSED
+} BotState;
+
+typedef struct {
+    int fd;
+    ShmLink link;             /* --shm: messages go here, fd only hangs up */
+    BotState state;
+    int tx_binary;            /* our commands are frames once we have asked */
+    int binary;               /* server frames from its PROTO answer on */
+    Hand hand;
+    Card up;
+    int hinted;               /* "ask": the server's hint for this prompt */
+    int turned_away;          /* closed on SERVER_FULL, not a drop */
+    long sent_ns;             /* decision in flight since, 0 if none */
+    RxBuf rx;
+} Bot;
+
+/* returns the op to send at a PROMPT */
+typedef int (*BotStrategy)(Bot *b);
+
+static struct {
+    long decisions;
+    long rounds;
+    long full;                /* SERVER_FULL answers */
+    long dropped;             /* connections lost mid-run */
+    int started;              /* connects attempted */
+    long *lat;                /* decision latencies, ns */
+    size_t nlat, caplat;
+} stats;
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void record_latency(long ns) {
+    if (stats.nlat == stats.caplat) {
+        size_t cap = stats.caplat ? stats.caplat * 2 : 1 << 16;
+        long *nl = realloc(stats.lat, cap * sizeof(*nl));
+        if (!nl) return;
+        stats.lat = nl;
+        stats.caplat = cap;
+    }
+    stats.lat[stats.nlat++] = ns;
+}
+
+/* ---------- strategies ---------- */
+
+static int bot_stand(Bot *b) {
+    (void)b;
+    return OP_STAND;
+}
+
+static int bot_dealer(Bot *b) {
+    return hand_value(&b->hand) < 17 ? OP_HIT : OP_STAND;
+}
+
+/* the server's own tables, looked up locally */
+static int bot_hint(Bot *b) {
+    return strategy_hint(&b->hand, b->up) == HINT_HIT ? OP_HIT : OP_STAND;
+}
+
+/* ask the server with HINT first, then do what it says */
+static int bot_ask(Bot *b) {
+    if (b->hinted < 0) return OP_HINT;
+    return b->hinted == HINT_HIT ? OP_HIT : OP_STAND;
+}
+
+static const struct {
+    const char *name;
+    BotStrategy fn;
+} strategies[] = {
+    { "ask",    bot_ask    },
+    { "dealer", bot_dealer },
+    { "hint",   bot_hint   },
+    { "stand",  bot_stand  },
+};
+
+static BotStrategy strategy = bot_hint;
+
+/* ---------- bots ---------- */
+
+static const char *shm_path = NULL;   /* --shm: the server's --shm-socket */
+
+static void bot_close(Bot *b, int epfd) {
+    if (b->state == BOT_CLOSED) return;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, b->fd, NULL);
+    close(b->fd);
+    if (b->link.ch) shm_link_close(&b->link);   // closing the bell unregisters it
+    b->state = BOT_CLOSED;
+}
+
+/* All of it or -1 */
+static int bot_write(Bot *b, const char *buf, size_t len) {
+    if (b->link.ch) return shm_send(&b->link, buf, len) == len ? 0 : -1;
+    return send(b->fd, buf, len, MSG_NOSIGNAL) == (ssize_t)len ? 0 : -1;
+}
+
+static int bot_send(Bot *b, int op) {
+    if (b->tx_binary) {
+        char frame[2] = { 1, (char)op };
+        return bot_write(b, frame, sizeof(frame));
+    }
+    char line[32];
+    int n = snprintf(line, sizeof(line), "%s\n", proto_op_name(op));
+    return bot_write(b, line, (size_t)n);
+}
+
+static void set_hand(Bot *b, const ProtoMsg *m) {
+    hand_init(&b->hand);
+    for (int i = 0; i < m->ncards; i++) hand_add_card(&b->hand, m->cards[i]);
+}
+
+/* -1 to drop the connection */
+static int bot_handle(Bot *b, const ProtoMsg *m, int want_binary) {
+    switch (m->op) {
+    case OP_WELCOME:
+        if (want_binary && !b->tx_binary) {
+            if (bot_write(b, "PROTO BINARY\n", 13) < 0) return -1;
+            b->tx_binary = 1;
+        }
+        break;
+    case OP_PROTO:
+        b->binary = 1;
+        break;
+    case OP_SERVER_FULL:
+        stats.full++;
+        b->turned_away = 1;
+        return -1;
+    case OP_DEALER_UP:
+        b->up = m->ncards ? m->cards[0] : 0;
+        break;
+    case OP_YOUR_HAND:
+    case OP_HAND:
+        set_hand(b, m);
+        break;
+    case OP_HIT:
+        if (m->ncards) hand_add_card(&b->hand, m->cards[0]);
+        break;
+    case OP_HINT:
+        b->hinted = m->value;
+        break;
+    case OP_ROUND_END:
+        stats.rounds++;
+        break;
+    case OP_PROMPT: {
+        int op = strategy(b);
+        if (op != OP_HINT) b->hinted = -1;
+        if (bot_send(b, op) < 0) return -1;
+        b->sent_ns = now_ns();
+        stats.decisions++;
+        break;
+    }
+    default:
+        break;
+    }
+    return 0;
+}
+
+/* Bytes moved into rx: >0, 0 if there are none for now, -1 if closed */
+static ssize_t bot_fill(Bot *b) {
+    if (!b->link.ch) {
+        ssize_t r = rxbuf_fill(&b->rx, b->fd, MSG_DONTWAIT);
+        if (r == 0) return -1;
+        if (r < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        return r;
+    }
+    const char *p;
+    size_t n = shm_peek(&b->link, &p);
+    if (n == 0) {
+        if (shm_idle(&b->link)) return 0;   // the server rings when it writes
+        n = shm_peek(&b->link, &p);
+    }
+    n = rxbuf_append(&b->rx, p, n);
+    if (n == 0) return -1;
+    shm_consume(&b->link, n);
+    return (ssize_t)n;
+}
+
+static int bot_read(Bot *b, int want_binary) {
+    for (;;) {
+        ssize_t r = bot_fill(b);
+        if (r <= 0) return (int)r;
+        if (b->sent_ns) {
+            record_latency(now_ns() - b->sent_ns);
+            b->sent_ns = 0;
+        }
+
+        for (;;) {
+            ProtoMsg m;
+            if (b->binary) {
+                size_t len;
+                unsigned char *f = rxbuf_next_frame(&b->rx, &len);
+                if (!f) break;
+                proto_decode_frame(f, len, &m);
+            } else {
+                char *line = rxbuf_next_line(&b->rx, NULL);
+                if (!line) break;
+                proto_decode_line(line, &m);
+            }
+            if (bot_handle(b, &m, want_binary) < 0) return -1;
+        }
+    }
+}
+
+static int bot_connect(Bot *b, int epfd, const struct sockaddr_in *addr) {
+    memset(b, 0, sizeof(*b));
+    b->hinted = -1;
+    b->link.bell = b->link.peer_bell = -1;
+    rxbuf_init(&b->rx);
+    b->fd = socket(shm_path ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (b->fd < 0) {
+        perror("socket");
+        b->state = BOT_CLOSED;
+        return -1;
+    }
+    int rc;
+    if (shm_path) {
+        struct sockaddr_un un;
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strncpy(un.sun_path, shm_path, sizeof(un.sun_path) - 1);
+        rc = connect(b->fd, (const struct sockaddr *)&un, sizeof(un));
+    } else {
+        int one = 1;
+        setsockopt(b->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        rc = connect(b->fd, (const struct sockaddr *)addr, sizeof(*addr));
+    }
+    if (rc < 0 && errno != EINPROGRESS) {
+        perror("connect");
+        close(b->fd);
+        b->state = BOT_CLOSED;
+        return -1;
+    }
+    b->state = BOT_CONNECTING;
+
+    // over TCP writability says the connect finished; a local bot instead
+    // waits for its channel to arrive
+    struct epoll_event ev;
+    ev.events = (shm_path ? 0 : EPOLLOUT) | EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = b;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, b->fd, &ev) < 0) {
+        perror("epoll_ctl");
+        close(b->fd);
+        b->state = BOT_CLOSED;
+        return -1;
+    }
+    return 0;
+}
+
+/* The server's answer to a local connect: the channel, mapped, with its
+ * doorbell in the loop; 0 if it hasn't come yet, -1 if it won't */
+static int bot_attach(Bot *b, int epfd) {
+    if (shm_link_accept(&b->link, b->fd) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        if (errno == EPROTO) {
+            stats.full++;   // SERVER_FULL, as text on the socket
+            b->turned_away = 1;
+        }
+        return -1;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = b;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, b->link.bell, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 1;
+}
+
+/* ---------- report ---------- */
+
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+static double lat_pct(double p) {
+    if (stats.nlat == 0) return 0.0;
+    size_t k = (size_t)(p / 100.0 * (double)stats.nlat + 0.5);
+    if (k < 1) k = 1;
+    if (k > stats.nlat) k = stats.nlat;
+    return (double)stats.lat[k - 1] / 1000.0;
+}
+
+static void report(int bots, int playing, int connecting, double elapsed) {
+    qsort(stats.lat, stats.nlat, sizeof(*stats.lat), cmp_long);
+    printf("bots          %d requested, %d playing at the end, %d still connecting\n",
+           bots, playing, connecting + (bots - stats.started));
+    printf("              %ld turned away, %ld dropped\n", stats.full, stats.dropped);
+    printf("elapsed       %.2f s\n", elapsed);
+    printf("decisions     %ld (%.0f/sec)\n", stats.decisions, (double)stats.decisions / elapsed);
+    printf("rounds        %ld bot-rounds (%.0f/sec)\n", stats.rounds, (double)stats.rounds / elapsed);
+    printf("latency (us)  p50 %.1f  p99 %.1f  p999 %.1f  max %.1f  (%zu samples)\n",
+           lat_pct(50), lat_pct(99), lat_pct(99.9), lat_pct(100), stats.nlat);
+}
+
+/* ---------- main ---------- */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s <server-ip> <port> [--bots N] [--duration SEC]\n"
+            "          [--strategy NAME] [--binary] [--connect-burst N]\n"
+            "       %s --shm <path> [options as above]\n"
+            "strategies:", prog, prog);
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++)
+        fprintf(stderr, " %s", strategies[i].name);
+    fprintf(stderr, "\n");
+}
+
+/* Thousands of sockets need more than the usual 1024 descriptors */
+static void raise_fd_limit(int want) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) return;
+    if (rl.rlim_cur >= (rlim_t)want) return;
+    rl.rlim_cur = rl.rlim_max < (rlim_t)want ? rl.rlim_max : (rlim_t)want;
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0) perror("setrlimit");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    int nbots = 1000;
+    double duration = 10.0;
+    int want_binary = 0;
+    int burst = 128;
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+            nbots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            strategy = NULL;
+            for (size_t k = 0; k < sizeof(strategies) / sizeof(strategies[0]); k++) {
+                if (strcmp(name, strategies[k].name) == 0) strategy = strategies[k].fn;
+            }
+            if (!strategy) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            want_binary = 1;
+        } else if (strcmp(argv[i], "--connect-burst") == 0 && i + 1 < argc) {
+            burst = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (nbots < 1 || burst < 1 || !(duration > 0.0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    if (strcmp(argv[1], "--shm") == 0) {
+        shm_path = argv[2];
+    } else {
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(argv[2]));
+        if (inet_pton(AF_INET, argv[1], &addr.sin_addr) <= 0) {
+            fprintf(stderr, "Invalid address: %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    raise_fd_limit(nbots + 64);
+    Bot *bots = calloc((size_t)nbots, sizeof(*bots));
+    int epfd = epoll_create1(0);
+    if (!bots || epfd < 0) {
+        perror("setup");
+        return 1;
+    }
+
+    int started = 0, connecting = 0, playing = 0;
+    long t0 = now_ns();
+    long end = t0 + (long)(duration * 1e9);
+    struct epoll_event events[MAX_EVENTS];
+
+    while (now_ns() < end) {
+        while (started < nbots && connecting < burst) {
+            if (bot_connect(&bots[started++], epfd, &addr) == 0) connecting++;
+        }
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, 100);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            Bot *b = events[i].data.ptr;
+            uint32_t ev = events[i].events;
+            if (b->state == BOT_CLOSED) continue;
+
+            if (b->state == BOT_CONNECTING) {
+                int err = 0;
+                if (shm_path) {
+                    int r = bot_attach(b, epfd);
+                    if (r == 0) continue;
+                    err = r < 0;
+                } else {
+                    socklen_t elen = sizeof(err);
+                    getsockopt(b->fd, SOL_SOCKET, SO_ERROR, &err, &elen);
+                }
+                connecting--;
+                if (err) {
+                    if (!b->turned_away) stats.dropped++;
+                    bot_close(b, epfd);
+                    continue;
+                }
+                b->state = BOT_PLAYING;
+                playing++;
+                struct epoll_event mod;
+                mod.events = (shm_path ? 0 : EPOLLIN) | EPOLLRDHUP;
+                mod.data.ptr = b;
+                epoll_ctl(epfd, EPOLL_CTL_MOD, b->fd, &mod);
+            }
+
+            if (bot_read(b, want_binary) < 0 || (ev & (EPOLLHUP | EPOLLERR)) ||
+                (b->link.ch && (ev & EPOLLRDHUP))) {
+                if (b->state == BOT_PLAYING) playing--;
+                if (!b->turned_away) stats.dropped++;
+                bot_close(b, epfd);
+            }
+        }
+    }
+
+    double elapsed = (double)(now_ns() - t0) / 1e9;
+    stats.started = started;
+    report(nbots, playing, connecting, elapsed);
+
+    for (int i = 0; i < started; i++) bot_close(&bots[i], epfd);
+    close(epfd);
+    free(bots);
+    free(stats.lat);
+    return 0;
+}
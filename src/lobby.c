@@ -0,0 +1,55 @@
+#include "../include/lobby.h"
+#include <string.h>
+
+void lobby_init(Lobby *l) {
+    memset(l, 0, sizeof(*l));
+}
+
+static void unfile(Table *t) {
+    if (!t->pprev_open) return;
+    *t->pprev_open = t->next_open;
+    if (t->next_open) t->next_open->pprev_open = t->pprev_open;
+    t->next_open = NULL;
+    t->pprev_open = NULL;
+}
+
+void lobby_update(Table *t) {
+    if (!t->index) return;
+    unfile(t);
+    int n = table_count_active(t);
+    if (n == MAX_PLAYERS) return;
+
+    Table **head = &t->index->open[n];
+    t->next_open = *head;
+    if (*head) (*head)->pprev_open = &t->next_open;
+    t->pprev_open = head;
+    *head = t;
+}
+
+void lobby_add(Lobby *l, Table *t) {
+    t->index = l;
+    lobby_update(t);
+}
+
+Table *lobby_place(Lobby *l) {
+    for (int n = MAX_PLAYERS - 1; n >= 0; n--)
+        if (l->open[n]) return l->open[n];
+    return NULL;
+}
+
+Table *lobby_merge_target(Lobby *l, Table *t) {
+    int n = table_count_active(t);
+    if (n == 0 || n >= LOBBY_MERGE_BELOW) return NULL;
+
+    // a table mid-round would seat them with nothing to play until it ends,
+    // so only idle ones qualify; a few looks per bucket keep this bounded
+    for (int c = MAX_PLAYERS - n; c >= n; c--) {
+        int looks = LOBBY_MERGE_PROBES;
+        for (Table *o = l->open[c]; o && looks > 0; o = o->next_open) {
+            if (o == t) continue;
+            if (o->state == TABLE_IDLE) return o;
+            looks--;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,63 @@
+#include "../include/pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* What malloc guarantees on the platforms we build for */
+#define POOL_ALIGN 16
+
+/* Slab header; the objects start POOL_ALIGN bytes in */
+typedef struct PoolSlab {
+    struct PoolSlab *next;
+} PoolSlab;
+
+void pool_init(Pool *p, size_t size) {
+    if (size < sizeof(void *)) size = sizeof(void *);
+    p->size = (size + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+    p->free = NULL;
+    p->slabs = NULL;
+    p->live = 0;
+    p->capacity = 0;
+}
+
+static int grow(Pool *p) {
+    PoolSlab *slab = malloc(POOL_ALIGN + p->size * POOL_SLAB_OBJS);
+    if (!slab) return -1;
+    slab->next = p->slabs;
+    p->slabs = slab;
+
+    // thread the new objects onto the free list, first object on top
+    for (int i = POOL_SLAB_OBJS - 1; i >= 0; i--) {
+        void *obj = (char *)slab + POOL_ALIGN + (size_t)i * p->size;
+        *(void **)obj = p->free;
+        p->free = obj;
+    }
+    p->capacity += POOL_SLAB_OBJS;
+    return 0;
+}
+
+void *pool_alloc(Pool *p) {
+    if (!p->free && grow(p) < 0) return NULL;
+    void *obj = p->free;
+    p->free = *(void **)obj;
+    memset(obj, 0, p->size);
+    p->live++;
+    return obj;
+}
+
+void pool_free(Pool *p, void *obj) {
+    if (!obj) return;
+    *(void **)obj = p->free;
+    p->free = obj;
+    p->live--;
+}
+
+void pool_destroy(Pool *p) {
+    while (p->slabs) {
+        PoolSlab *next = p->slabs->next;
+        free(p->slabs);
+        p->slabs = next;
+    }
+    p->free = NULL;
+    p->live = 0;
+    p->capacity = 0;
+}
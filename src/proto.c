@@ -0,0 +1,357 @@
+#include "../include/proto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum { ARG_NONE, ARG_INT, ARG_CARD, ARG_CARDS } ArgKind;
+
+#define OP(name, arg) { name, sizeof(name) - 1, arg }
+
+static const struct {
+    const char *name;
+    uint8_t len;
+    ArgKind arg;
+} op_info[OP_COUNT] = {
+    [OP_NONE]            = OP("",                ARG_NONE),
+    [OP_WELCOME]         = OP("WELCOME",         ARG_INT),
+    [OP_SERVER_FULL]     = OP("SERVER_FULL",     ARG_NONE),
+    [OP_DEALER_UP]       = OP("DEALER_UP",       ARG_CARD),
+    [OP_YOUR_HAND]       = OP("YOUR_HAND",       ARG_CARDS),
+    [OP_YOUR_TURN]       = OP("YOUR_TURN",       ARG_NONE),
+    [OP_HAND]            = OP("HAND",            ARG_CARDS),
+    [OP_PROMPT]          = OP("PROMPT",          ARG_NONE),
+    [OP_HIT]             = OP("HIT",             ARG_CARD),
+    [OP_STAND]           = OP("STAND",           ARG_INT),
+    [OP_BUST]            = OP("BUST",            ARG_INT),
+    [OP_BLACKJACK]       = OP("BLACKJACK",       ARG_NONE),
+    [OP_DEALER_HAND]     = OP("DEALER_HAND",     ARG_CARDS),
+    [OP_DEALER_VALUE]    = OP("DEALER_VALUE",    ARG_INT),
+    [OP_PLAYER_VALUE]    = OP("PLAYER_VALUE",    ARG_INT),
+    [OP_RESULT]          = OP("RESULT",          ARG_INT),
+    [OP_ROUND_END]       = OP("ROUND_END",       ARG_NONE),
+    [OP_UNKNOWN_COMMAND] = OP("UNKNOWN_COMMAND", ARG_NONE),
+    [OP_PROTO]           = OP("PROTO",           ARG_NONE),
+    [OP_HINT]            = OP("HINT",            ARG_INT),
+    [OP_SEAT]            = OP("SEAT",            ARG_INT),
+    [OP_WATCH]           = OP("WATCH",           ARG_NONE),
+};
+
+/* Keywords in strcmp order, for proto_text_op() */
+static const struct {
+    const char *name;
+    int op;
+} keywords[] = {
+    { "BLACKJACK",       OP_BLACKJACK       },
+    { "BUST",            OP_BUST            },
+    { "DEALER_HAND",     OP_DEALER_HAND     },
+    { "DEALER_UP",       OP_DEALER_UP       },
+    { "DEALER_VALUE",    OP_DEALER_VALUE    },
+    { "HAND",            OP_HAND            },
+    { "HINT",            OP_HINT            },
+    { "HIT",             OP_HIT             },
+    { "PLAYER_VALUE",    OP_PLAYER_VALUE    },
+    { "PROMPT",          OP_PROMPT          },
+    { "PROTO",           OP_PROTO           },
+    { "RESULT",          OP_RESULT          },
+    { "ROUND_END",       OP_ROUND_END       },
+    { "SEAT",            OP_SEAT            },
+    { "SERVER_FULL",     OP_SERVER_FULL     },
+    { "STAND",           OP_STAND           },
+    { "UNKNOWN_COMMAND", OP_UNKNOWN_COMMAND },
+    { "WATCH",           OP_WATCH           },
+    { "WELCOME",         OP_WELCOME         },
+    { "YOUR_HAND",       OP_YOUR_HAND       },
+    { "YOUR_TURN",       OP_YOUR_TURN       },
+};
+
+static const char *result_names[] = { "LOSE", "WIN", "PUSH" };
+static const char *hint_names[] = { "STAND", "HIT" };
+
+/* ---------- cards ---------- */
+
+unsigned char proto_card_byte(Card c) {
+    return c;
+}
+
+Card proto_byte_card(unsigned char b) {
+    return (Card)b;
+}
+
+static int parse_card(const char *s, size_t len, Card *out) {
+    if (len < 2 || len > 3) return -1;
+    const char *suits = "CDHS";
+    const char *sp = memchr(suits, s[len - 1], 4);
+    if (!sp) return -1;
+
+    int rank;
+    if (len == 3) {
+        if (s[0] != '1' || s[1] != '0') return -1;
+        rank = 10;
+    } else if (s[0] == 'A') rank = 1;
+    else if (s[0] == 'J') rank = 11;
+    else if (s[0] == 'Q') rank = 12;
+    else if (s[0] == 'K') rank = 13;
+    else if (s[0] >= '2' && s[0] <= '9') rank = s[0] - '0';
+    else return -1;
+
+    *out = card_make(rank, (int)(sp - suits));
+    return 0;
+}
+
+/* ---------- keywords ---------- */
+
+int proto_text_op(const char *word, size_t len) {
+    size_t lo = 0, hi = sizeof(keywords) / sizeof(keywords[0]);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const char *name = keywords[mid].name;
+        int c = strncmp(word, name, len);
+        if (c == 0 && name[len] != '\0') c = -1;   // word is a prefix of name
+        if (c == 0) return keywords[mid].op;
+        if (c < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    return OP_NONE;
+}
+
+const char *proto_op_name(int op) {
+    if (op <= OP_NONE || op >= OP_COUNT) return "?";
+    return op_info[op].name;
+}
+
+/* ---------- encoders ---------- */
+
+static size_t put_frame(char *buf, size_t room, int op,
+                        const unsigned char *payload, size_t n) {
+    if (n + 2 > room || n + 1 > 255) return 0;
+    buf[0] = (char)(n + 1);
+    buf[1] = (char)op;
+    if (n) memcpy(buf + 2, payload, n);
+    return n + 2;
+}
+
+/* Text messages are appended piece by piece into the caller's buffer: a
+ * keyword of known length, card names from card_names[], integers by hand.
+ * Like snprintf, a message that would not leave room for the terminating
+ * NUL is not written at all (0 is returned). */
+typedef struct {
+    char *p;
+    char *end;                /* one before the end: room for the NUL */
+    int full;
+} Text;
+
+static void text_init(Text *t, char *buf, size_t room) {
+    t->p = buf;
+    t->end = room ? buf + room - 1 : buf;
+    t->full = room == 0;
+}
+
+static void text_bytes(Text *t, const char *s, size_t n) {
+    if (t->full || n > (size_t)(t->end - t->p)) {
+        t->full = 1;
+        return;
+    }
+    memcpy(t->p, s, n);
+    t->p += n;
+}
+
+static void text_char(Text *t, char c) {
+    if (t->full || t->p == t->end) {
+        t->full = 1;
+        return;
+    }
+    *t->p++ = c;
+}
+
+static void text_int(Text *t, int value) {
+    char digits[12];
+    char *d = digits + sizeof(digits);
+    unsigned int v = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do {
+        *--d = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (value < 0) *--d = '-';
+    text_bytes(t, d, (size_t)(digits + sizeof(digits) - d));
+}
+
+static void text_card(Text *t, Card c) {
+    size_t n = card_name_len(c);
+    if (n) {
+        text_bytes(t, card_names[c & 63], n);
+        return;
+    }
+    char buf[8];
+    card_to_string(c, buf, sizeof(buf));
+    text_bytes(t, buf, strlen(buf));
+}
+
+static void text_keyword(Text *t, int op) {
+    text_bytes(t, op_info[op].name, op_info[op].len);
+}
+
+static size_t text_end(Text *t, char *buf) {
+    text_char(t, '\n');
+    if (t->full) return 0;
+    *t->p = '\0';
+    return (size_t)(t->p - buf);
+}
+
+static size_t put_literal(char *buf, size_t room, const char *line, size_t n) {
+    if (n >= room) return 0;
+    memcpy(buf, line, n + 1);
+    return n;
+}
+
+#define PUT_LITERAL(buf, room, s) put_literal(buf, room, s, sizeof(s) - 1)
+
+size_t proto_put_simple(char *buf, size_t room, int binary, int op) {
+    if (binary) return put_frame(buf, room, op, NULL, 0);
+
+    if (op == OP_PROMPT) return PUT_LITERAL(buf, room, "PROMPT HIT or STAND\n");
+    if (op == OP_PROTO)  return PUT_LITERAL(buf, room, "PROTO BINARY\n");
+    Text t;
+    text_init(&t, buf, room);
+    text_keyword(&t, op);
+    return text_end(&t, buf);
+}
+
+size_t proto_put_int(char *buf, size_t room, int binary, int op, int value) {
+    if (binary) {
+        unsigned char v = (unsigned char)value;
+        return put_frame(buf, room, op, &v, 1);
+    }
+
+    Text t;
+    text_init(&t, buf, room);
+    text_keyword(&t, op);
+    text_char(&t, ' ');
+    if (op == OP_RESULT && value >= 0 && value <= RESULT_PUSH) {
+        text_bytes(&t, result_names[value], strlen(result_names[value]));
+    } else if (op == OP_HINT && value >= HINT_STAND && value <= HINT_HIT) {
+        text_bytes(&t, hint_names[value], strlen(hint_names[value]));
+    } else {
+        if (op == OP_WELCOME) text_bytes(&t, "Player ", 7);
+        text_int(&t, value);
+    }
+    return text_end(&t, buf);
+}
+
+size_t proto_put_card(char *buf, size_t room, int binary, int op, Card c) {
+    if (binary) {
+        unsigned char b = proto_card_byte(c);
+        return put_frame(buf, room, op, &b, 1);
+    }
+
+    Text t;
+    text_init(&t, buf, room);
+    text_keyword(&t, op);
+    text_char(&t, ' ');
+    text_card(&t, c);
+    return text_end(&t, buf);
+}
+
+size_t proto_put_hand(char *buf, size_t room, int binary, int op, const Hand *h) {
+    if (binary) {
+        unsigned char bytes[MAX_HAND_CARDS];
+        for (int i = 0; i < h->count; i++) bytes[i] = proto_card_byte(h->cards[i]);
+        return put_frame(buf, room, op, bytes, (size_t)h->count);
+    }
+
+    Text t;
+    text_init(&t, buf, room);
+    text_keyword(&t, op);
+    text_char(&t, ' ');
+    for (int i = 0; i < h->count; i++) {
+        if (i > 0) text_char(&t, ' ');
+        text_card(&t, h->cards[i]);
+    }
+    return text_end(&t, buf);
+}
+
+/* ---------- decoders ---------- */
+
+int proto_decode_line(char *line, ProtoMsg *m) {
+    memset(m, 0, sizeof(*m));
+
+    char *arg = strchr(line, ' ');
+    size_t wlen = arg ? (size_t)(arg - line) : strlen(line);
+    m->op = proto_text_op(line, wlen);
+    if (arg) {
+        *arg++ = '\0';
+        m->arg = arg;
+    }
+    if (m->op == OP_NONE) return -1;
+
+    switch (op_info[m->op].arg) {
+    case ARG_NONE:
+        return 0;
+
+    case ARG_INT:
+        if (!arg) return m->op == OP_HINT ? 0 : -1;  // a client's HINT asks
+        if (m->op == OP_RESULT) {
+            for (int i = 0; i <= RESULT_PUSH; i++) {
+                if (strcmp(arg, result_names[i]) == 0) {
+                    m->value = i;
+                    return 0;
+                }
+            }
+            return -1;
+        }
+        if (m->op == OP_HINT) {
+            for (int i = HINT_STAND; i <= HINT_HIT; i++) {
+                if (strcmp(arg, hint_names[i]) == 0) {
+                    m->value = i;
+                    return 0;
+                }
+            }
+            return -1;
+        }
+        if (m->op == OP_WELCOME && strncmp(arg, "Player ", 7) == 0) arg += 7;
+        m->value = atoi(arg);
+        return 0;
+
+    case ARG_CARD:
+    case ARG_CARDS: {
+        if (!arg) return m->op == OP_HIT ? 0 : -1;   // a client's HIT has no card
+        const char *p = arg;
+        while (*p && m->ncards < MAX_HAND_CARDS) {
+            while (*p == ' ') p++;
+            size_t n = strcspn(p, " ");
+            if (n == 0) break;
+            if (parse_card(p, n, &m->cards[m->ncards]) < 0) return -1;
+            m->ncards++;
+            p += n;
+        }
+        return m->ncards > 0 ? 0 : -1;
+    }
+    }
+    return -1;
+}
+
+int proto_decode_frame(const unsigned char *frame, size_t len, ProtoMsg *m) {
+    memset(m, 0, sizeof(*m));
+    if (len < 1) return -1;
+
+    int op = frame[0];
+    if (op <= OP_NONE || op >= OP_COUNT) return -1;
+    m->op = op;
+
+    const unsigned char *payload = frame + 1;
+    size_t n = len - 1;
+    switch (op_info[op].arg) {
+    case ARG_NONE:
+        return 0;
+    case ARG_INT:
+        if (n == 0) return (op == OP_STAND || op == OP_HINT) ? 0 : -1;   // client commands carry no value
+        m->value = payload[0];
+        return 0;
+    case ARG_CARD:
+    case ARG_CARDS:
+        if (n > MAX_HAND_CARDS) n = MAX_HAND_CARDS;
+        for (size_t i = 0; i < n; i++) m->cards[i] = proto_byte_card(payload[i]);
+        m->ncards = (int)n;
+        return (n > 0 || op == OP_HIT) ? 0 : -1;
+    }
+    return -1;
+}
@@ -0,0 +1,315 @@
+/*
+ * Round journal replay
+ * Maps a journal written by ./server --journal and re-deals every round
+ * from its table's seed: each card, each decision's legality and each
+ * result must come out exactly as recorded.
+ *
+ * Usage: ./replay <journal> [--table N]
+ *
+ * --table N also prints that table's rounds, card by card, for settling
+ * a dispute. Exits 1 if any round failed to replay.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/journal.h"
+#include "../include/proto.h"
+
+/* Mismatches printed in full; the rest are only counted */
+#define MAX_REPORTED 20
+
+/* Further than this many shoes from where a table's shoe is: a bad record */
+#define MAX_SHUFFLES_AHEAD (1u << 24)
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <journal> [--table N]\n", prog);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* ---------- tables' shoes ---------- */
+
+/* Each table's shoe as of its last replayed round, so following a table
+ * through the journal shuffles each shoe once, as the server did */
+typedef struct {
+    uint32_t table;
+    uint64_t seed;
+    Shoe shoe;
+} TableShoe;
+
+/* A shoe's card pointers aim into the shoe itself, so each lives in its own
+ * allocation and growing the map moves only pointers */
+typedef struct {
+    TableShoe **slots;        /* NULL: empty */
+    size_t cap;               /* a power of two */
+    size_t count;
+} ShoeMap;
+
+static size_t slot_of(const ShoeMap *m, uint32_t table) {
+    size_t i = (size_t)(table * 2654435761u) & (m->cap - 1);
+    while (m->slots[i] && m->slots[i]->table != table) i = (i + 1) & (m->cap - 1);
+    return i;
+}
+
+static int map_grow(ShoeMap *m) {
+    ShoeMap bigger = { NULL, m->cap ? m->cap * 2 : 64, 0 };
+    bigger.slots = calloc(bigger.cap, sizeof(*bigger.slots));
+    if (!bigger.slots) return -1;
+    for (size_t i = 0; i < m->cap; i++) {
+        if (!m->slots[i]) continue;
+        bigger.slots[slot_of(&bigger, m->slots[i]->table)] = m->slots[i];
+        bigger.count++;
+    }
+    free(m->slots);
+    *m = bigger;
+    return 0;
+}
+
+static void map_free(ShoeMap *m) {
+    for (size_t i = 0; i < m->cap; i++) free(m->slots[i]);
+    free(m->slots);
+}
+
+/* The table's shoe, dealt up to the record's first card; NULL (with why)
+ * if the record names a shoe that can't be reached */
+static Shoe *position_shoe(ShoeMap *m, const JournalRecord *r, const char **why) {
+    if ((m->count + 1) * 2 > m->cap && map_grow(m) < 0) {
+        *why = "out of memory";
+        return NULL;
+    }
+    TableShoe **slot = &m->slots[slot_of(m, r->table)];
+    TableShoe *ts = *slot;
+    int fresh = !ts;
+    if (fresh) {
+        ts = malloc(sizeof(*ts));
+        if (!ts) {
+            *why = "out of memory";
+            return NULL;
+        }
+        ts->table = r->table;
+    }
+
+    // a new table, a new seed (a restarted server), or a shoe already past this one
+    Shoe *shoe = &ts->shoe;
+    if (fresh || ts->seed != r->seed || shoe->ndecks != r->ndecks || shoe->shuffles > r->shuffles) {
+        if (shoe_init_seeded(shoe, r->ndecks, 1.0, r->seed) < 0) {
+            // a slot already in use keeps its shoe: later tables may have probed past it
+            if (fresh) free(ts);
+            *why = "bad shoe size";
+            return NULL;
+        }
+        ts->seed = r->seed;
+    }
+    if (fresh) {
+        *slot = ts;
+        m->count++;
+    }
+    if (r->shuffles - shoe->shuffles > MAX_SHUFFLES_AHEAD) {
+        *why = "shoe out of reach";
+        return NULL;
+    }
+    while (shoe->shuffles < r->shuffles) shoe_shuffle(shoe);
+    if (r->top > shoe->size) {
+        *why = "bad shoe position";
+        return NULL;
+    }
+    shoe->top = r->top;
+    return shoe;
+}
+
+/* ---------- replaying a round ---------- */
+
+typedef struct {
+    Hand seats[JOURNAL_MAX_SEATS];
+    Hand dealer;
+    unsigned done;            /* seats that finished acting */
+    unsigned gone;
+    int next;                 /* recorded cards checked so far */
+} Round;
+
+/* Deal the shoe's next card to h; -1 unless it is the recorded one */
+static int deal(Shoe *shoe, const JournalEntry *e, Round *rd, Hand *h) {
+    Card c = shoe_deal(shoe);
+    if (rd->next == e->rec.ncards || e->cards[rd->next] != c) return -1;
+    rd->next++;
+    hand_add_card(h, c);
+    return 0;
+}
+
+static int result_of(const Hand *player, const Hand *dealer) {
+    int outcome = hand_outcome(player, dealer);
+    return outcome > 0 ? RESULT_WIN : outcome < 0 ? RESULT_LOSE : RESULT_PUSH;
+}
+
+/* Play the record's round again through the engine: NULL if everything
+ * matches, otherwise what didn't */
+static const char *replay_round(Shoe *shoe, const JournalEntry *e, Round *rd) {
+    unsigned seats = e->rec.seats;
+    memset(rd, 0, sizeof(*rd));
+    for (unsigned m = seats; m; m &= m - 1) hand_init(&rd->seats[__builtin_ctz(m)]);
+    hand_init(&rd->dealer);
+
+    for (int r = 0; r < 2; r++) {
+        for (unsigned m = seats; m; m &= m - 1)
+            if (deal(shoe, e, rd, &rd->seats[__builtin_ctz(m)]) < 0) return "initial deal differs";
+        if (deal(shoe, e, rd, &rd->dealer) < 0) return "initial deal differs";
+    }
+    for (unsigned m = seats; m; m &= m - 1) {
+        int i = __builtin_ctz(m);
+        if (hand_is_blackjack(&rd->seats[i])) rd->done |= 1u << i;
+    }
+
+    // seats act in order, each until it stands, busts or reaches 21
+    int turn = 0;
+    for (int k = 0; k < e->rec.nactions; k++) {
+        int seat = JOURNAL_SEAT(e->actions[k]), act = JOURNAL_KIND(e->actions[k]);
+        unsigned bit = 1u << seat;
+        if (!(seats & bit) || (rd->gone & bit)) return "action for a seat not in the round";
+        if (act == JOURNAL_ACT_LEFT) {
+            rd->gone |= bit;
+            continue;
+        }
+        if (rd->done & bit) return "action after the seat finished";
+        if (seat < turn) return "seats acted out of order";
+        turn = seat;
+
+        Hand *h = &rd->seats[seat];
+        if (act == JOURNAL_ACT_HIT) {
+            if (deal(shoe, e, rd, h) < 0) return "hit card differs";
+            if (hand_value(h) >= 21) rd->done |= bit;
+        } else if (act == JOURNAL_ACT_STAND || act == JOURNAL_ACT_TIMEOUT) {
+            rd->done |= bit;
+        } else {
+            return "unknown action";
+        }
+    }
+    if ((rd->done | rd->gone) != seats) return "a seat never finished its turn";
+
+    play_dealer_hand(&rd->dealer, shoe);
+    for (int i = 2; i < rd->dealer.count; i++)
+        if (rd->next == e->rec.ncards || e->cards[rd->next++] != rd->dealer.cards[i])
+            return "dealer draw differs";
+    if (rd->next != e->rec.ncards) return "more cards recorded than dealt";
+
+    int n = 0;
+    for (unsigned m = seats; m; m &= m - 1, n++) {
+        int i = __builtin_ctz(m);
+        int want = (rd->gone & (1u << i)) ? JOURNAL_RES_GONE : result_of(&rd->seats[i], &rd->dealer);
+        if (e->results[n] != want) return "result differs";
+    }
+    return NULL;
+}
+
+/* ---------- printing ---------- */
+
+static const char *result_names[] = {
+    [RESULT_LOSE] = "LOSE", [RESULT_WIN] = "WIN", [RESULT_PUSH] = "PUSH", [JOURNAL_RES_GONE] = "left"
+};
+
+static void print_round(const JournalEntry *e, const Round *rd, const char *why) {
+    char when[32], cards[64];
+    time_t sec = (time_t)(e->rec.time_ms / 1000);
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+    printf("table %u round %u at %s.%03u (shoe %llu, card %u)%s%s\n",
+           e->rec.table, e->rec.round, when, (unsigned)(e->rec.time_ms % 1000),
+           (unsigned long long)e->rec.shuffles, e->rec.top, why ? ": " : "", why ? why : "");
+    if (why) return;   // the replayed hands stop short of the round
+
+    hand_to_string(&rd->dealer, cards, sizeof(cards));
+    printf("  dealer  %-24s %2d\n", cards, hand_value(&rd->dealer));
+    int n = 0;
+    for (unsigned m = e->rec.seats; m; m &= m - 1, n++) {
+        int i = __builtin_ctz(m);
+        hand_to_string(&rd->seats[i], cards, sizeof(cards));
+        printf("  seat %d  %-24s %2d  %s\n", i + 1, cards, hand_value(&rd->seats[i]),
+               result_names[e->results[n]]);
+    }
+}
+
+/* ---------- main ---------- */
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    long long only_table = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--table") == 0 && i + 1 < argc) {
+            only_table = atoll(argv[++i]);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat");
+        close(fd);
+        return 1;
+    }
+    size_t len = (size_t)st.st_size;
+    const char *map = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    if (journal_check_header(map, len) < 0) {
+        fprintf(stderr, "%s is not a round journal (or a different version)\n", path);
+        return 1;
+    }
+    madvise((void *)map, len, MADV_SEQUENTIAL);
+
+    ShoeMap shoes = { NULL, 0, 0 };
+    unsigned long long rounds = 0, bad = 0;
+    size_t off = sizeof(JournalHeader);
+    JournalEntry e;
+    Round rd;
+    int r;
+    double t0 = now_sec();
+    while ((r = journal_next(map, len, &off, &e)) > 0) {
+        rounds++;
+        const char *why = NULL;
+        Shoe *shoe = position_shoe(&shoes, &e.rec, &why);
+        if (shoe) why = replay_round(shoe, &e, &rd);
+        if (why) {
+            if (++bad <= MAX_REPORTED) print_round(&e, &rd, why);
+        } else if (only_table == (long long)e.rec.table) {
+            print_round(&e, &rd, NULL);
+        }
+    }
+    double secs = now_sec() - t0;
+
+    if (r < 0) printf("torn record at offset %zu: %zu bytes not read\n", off, len - off);
+    printf("%llu rounds replayed in %.3f s (%.2f M rounds/sec), %zu tables: %llu ok, %llu mismatched\n",
+           rounds, secs, secs > 0 ? (double)rounds / secs / 1e6 : 0.0, shoes.count,
+           rounds - bad, bad);
+    map_free(&shoes);
+    munmap((void *)map, len);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#include "../include/rng.h"
+#include <string.h>
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/* ---------- xoshiro256** ---------- */
+
+static inline uint64_t xoshiro_next(uint64_t *s) {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+static void xoshiro_jump(uint64_t *s) {
+    static const uint64_t JUMP[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (JUMP[i] & (1ULL << b)) {
+                s0 ^= s[0];
+                s1 ^= s[1];
+                s2 ^= s[2];
+                s3 ^= s[3];
+            }
+            xoshiro_next(s);
+        }
+    }
+    s[0] = s0;
+    s[1] = s1;
+    s[2] = s2;
+    s[3] = s3;
+}
+
+/* ---------- PCG32 (XSH RR) ---------- */
+
+#define PCG_MULT 6364136223846793005ULL
+
+static inline uint32_t pcg_next(uint64_t *s) {
+    uint64_t old = s[0];
+    s[0] = old * PCG_MULT + s[1];
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+/* LCG jump-ahead in O(log delta) (Brown, "Random number generation with
+ * arbitrary strides") */
+static void pcg_advance(uint64_t *s, uint64_t delta) {
+    uint64_t cur_mult = PCG_MULT, cur_plus = s[1];
+    uint64_t acc_mult = 1, acc_plus = 0;
+    while (delta > 0) {
+        if (delta & 1) {
+            acc_mult *= cur_mult;
+            acc_plus = acc_plus * cur_mult + cur_plus;
+        }
+        cur_plus = (cur_mult + 1) * cur_plus;
+        cur_mult *= cur_mult;
+        delta >>= 1;
+    }
+    s[0] = acc_mult * s[0] + acc_plus;
+}
+
+/* ---------- public API ---------- */
+
+void rng_seed(Rng *r, RngKind kind, uint64_t seed) {
+    uint64_t x = seed;
+    memset(r, 0, sizeof(*r));
+    r->kind = kind;
+    if (kind == RNG_PCG32) {
+        r->s[1] = (splitmix64(&x) << 1) | 1;   // increment must be odd
+        r->s[0] = 0;
+        pcg_next(r->s);
+        r->s[0] += splitmix64(&x);
+        pcg_next(r->s);
+        return;
+    }
+    for (int i = 0; i < 4; i++) r->s[i] = splitmix64(&x);
+}
+
+uint64_t rng_next64(Rng *r) {
+    if (r->kind == RNG_PCG32) {
+        uint64_t hi = pcg_next(r->s);
+        return (hi << 32) | pcg_next(r->s);
+    }
+    return xoshiro_next(r->s);
+}
+
+uint32_t rng_next32(Rng *r) {
+    if (r->kind == RNG_PCG32) return pcg_next(r->s);
+    return (uint32_t)(xoshiro_next(r->s) >> 32);
+}
+
+uint32_t rng_bounded(Rng *r, uint32_t n) {
+    uint64_t m = (uint64_t)rng_next32(r) * n;
+    uint32_t low = (uint32_t)m;
+    if (low < n) {
+        uint32_t threshold = (uint32_t)(-n) % n;
+        while (low < threshold) {
+            m = (uint64_t)rng_next32(r) * n;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+void rng_jump(Rng *r) {
+    if (r->kind == RNG_PCG32) pcg_advance(r->s, 1ULL << 48);
+    else xoshiro_jump(r->s);
+}
+
+void rng_split(Rng *parent, Rng *child) {
+    *child = *parent;
+    rng_jump(parent);
+}
+
+int rng_kind_from_name(const char *name, RngKind *kind) {
+    if (strcmp(name, "xoshiro") == 0 || strcmp(name, "xoshiro256**") == 0) {
+        *kind = RNG_XOSHIRO256SS;
+        return 0;
+    }
+    if (strcmp(name, "pcg") == 0 || strcmp(name, "pcg32") == 0) {
+        *kind = RNG_PCG32;
+        return 0;
+    }
+    return -1;
+}
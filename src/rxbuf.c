@@ -0,0 +1,112 @@
+#include "../include/rxbuf.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+void rxbuf_init(RxBuf *rb) {
+    rb->start = 0;
+    rb->scanned = 0;
+    rb->end = 0;
+}
+
+/* Slide unconsumed bytes back to the front if fewer than want are free */
+static size_t make_room(RxBuf *rb, size_t want) {
+    if (rb->start == rb->end) {
+        rb->start = rb->scanned = rb->end = 0;
+    } else if (sizeof(rb->data) - rb->end < want && rb->start > 0) {
+        size_t live = rb->end - rb->start;
+        memmove(rb->data, rb->data + rb->start, live);
+        rb->scanned -= rb->start;
+        rb->start = 0;
+        rb->end = live;
+    }
+    return sizeof(rb->data) - rb->end;
+}
+
+ssize_t rxbuf_fill(RxBuf *rb, int fd, int flags) {
+    size_t room = make_room(rb, 1);
+    if (room == 0) {
+        errno = ENOBUFS;   // caller must drain lines first
+        return -1;
+    }
+
+    ssize_t n;
+    do {
+        n = recv(fd, rb->data + rb->end, room, flags);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) rb->end += (size_t)n;
+    return n;
+}
+
+size_t rxbuf_room(RxBuf *rb) {
+    return make_room(rb, sizeof(rb->data));
+}
+
+size_t rxbuf_append(RxBuf *rb, const char *buf, size_t len) {
+    size_t room = make_room(rb, len);
+    if (len > room) len = room;
+    memcpy(rb->data + rb->end, buf, len);
+    rb->end += len;
+    return len;
+}
+
+/* Length of the next line and the bytes it occupies including the ending,
+ * or 0 if no complete line is buffered yet */
+static size_t find_line(RxBuf *rb, size_t *n) {
+    char *nl = memchr(rb->data + rb->scanned, '\n', rb->end - rb->scanned);
+    if (nl) {
+        *n = (size_t)(nl - (rb->data + rb->start));
+        return *n + 1;
+    }
+    if (rb->start == 0 && rb->end == sizeof(rb->data)) {
+        // no newline in a full buffer: hand it out truncated
+        *n = rb->end - 1;
+        return rb->end;
+    }
+    rb->scanned = rb->end;
+    return 0;
+}
+
+char *rxbuf_next_line(RxBuf *rb, size_t *len) {
+    size_t n;
+    size_t used = find_line(rb, &n);
+    if (!used) return NULL;
+
+    char *line = rb->data + rb->start;
+    rb->start += used;
+    rb->scanned = rb->start;
+
+    line[n] = '\0';
+    if (n > 0 && line[n - 1] == '\r') line[--n] = '\0';
+    if (len) *len = n;
+    return line;
+}
+
+const char *rxbuf_peek_line(RxBuf *rb, size_t *len) {
+    size_t n;
+    if (!find_line(rb, &n)) return NULL;
+
+    const char *line = rb->data + rb->start;
+    if (n > 0 && line[n - 1] == '\r') n--;
+    *len = n;
+    return line;
+}
+
+const unsigned char *rxbuf_peek_frame(const RxBuf *rb, size_t *len) {
+    if (rb->end - rb->start < 1) return NULL;
+    const unsigned char *p = (const unsigned char *)rb->data + rb->start;
+    if (rb->end - rb->start < 1 + (size_t)p[0]) return NULL;
+    *len = p[0];
+    return p + 1;
+}
+
+unsigned char *rxbuf_next_frame(RxBuf *rb, size_t *len) {
+    size_t n;
+    if (!rxbuf_peek_frame(rb, &n)) return NULL;
+
+    unsigned char *p = (unsigned char *)rb->data + rb->start + 1;
+    rb->start += 1 + n;
+    rb->scanned = rb->start;
+    *len = n;
+    return p;
+}
@@ -2,314 +2,245 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
-#include <sys/select.h>
-#include <ctype.h>
-#include <stdarg.h>
 
-#include "../include/blackjack.h"
-#include "../include/deck.h"
-
-#define MAX_PLAYERS 5
-#define BUFFER_SIZE 512
-
-typedef struct {
-    int socket_fd;
-    Hand hand;
-    int active;      // 1 = connected and playing, 0 = free slot
-} PlayerConn;
-
-/* ---------- helpers for sending / receiving ---------- */
-
-static ssize_t send_all(int fd, const char *buf, size_t len) {
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = send(fd, buf + sent, len - sent, 0);
-        if (n <= 0) return n;
-        sent += (size_t)n;
-    }
-    return (ssize_t)sent;
+#include "../include/conn.h"
+#include "../include/journal.h"
+#include "../include/shard.h"
+#include "../include/shm.h"
+#include "../include/stats.h"
+#include "../include/uring.h"
+
+/*
+ * The main thread only accepts. Every accepted socket is handed to the
+ * least-loaded shard (see shard.h); each shard runs its own epoll loop over
+ * its own tables, so rounds scale with the number of worker threads.
+ * --stats-socket PATH serves the shards' counters on a local Unix socket;
+ * --shm-socket PATH takes bots on the same host, whose messages then go
+ * through shared memory instead of TCP (see shm.h); --journal PATH records
+ * every round for replay (see journal.h).
+ */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [port] [--threads N] [--seed S] [--cork]\n"
+            "          [--decks 1-%d] [--penetration 0-1] [--shufflers N]\n"
+            "          [--turn-timeout SEC] [--idle-turns N] [--lobby-wait MS]\n"
+            "          [--stall-timeout SEC] [--backlog N] [--io epoll|uring]\n"
+            "          [--stats-socket PATH] [--shm-socket PATH]\n"
+            "          [--journal PATH] [--journal-sync-ms MS]\n",
+            prog, SHOE_MAX_DECKS);
 }
 
-static int sendf(int fd, const char *fmt, ...) {
-    char buf[BUFFER_SIZE];
-    va_list ap;
-    va_start(ap, fmt);
-    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
-    va_end(ap);
-    if (n <= 0) return -1;
-    return (send_all(fd, buf, (size_t)n) > 0) ? 0 : -1;
-}
-
-static int recv_line(int fd, char *buf, size_t bufsz) {
-    size_t idx = 0;
-    while (idx + 1 < bufsz) {
-        char c;
-        ssize_t r = recv(fd, &c, 1, 0);
-        if (r <= 0) return -1;     // error or disconnect
-        if (c == '\n') break;
-        buf[idx++] = c;
+/* Called from both accept threads */
+static Shard *pick_shard(Shard *shards, int nshards) {
+    static unsigned rr = 0;
+    unsigned start = __atomic_fetch_add(&rr, 1, __ATOMIC_RELAXED);
+    Shard *best = NULL;
+    int best_load = 0;
+    for (int k = 0; k < nshards; k++) {
+        Shard *s = &shards[(start + (unsigned)k) % (unsigned)nshards];
+        int load = shard_load(s);
+        if (!best || load < best_load) {
+            best = s;
+            best_load = load;
+        }
     }
-    buf[idx] = '\0';
-    return (int)idx;
+    return best;
 }
 
-static void trim_newline(char *s) {
-    size_t L = strlen(s);
-    while (L > 0 && (s[L - 1] == '\n' || s[L - 1] == '\r')) {
-        s[L - 1] = '\0';
-        L--;
-    }
+/* Every session is a descriptor: take all the hard limit allows */
+static void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0 || rl.rlim_cur == rl.rlim_max) return;
+    rl.rlim_cur = rl.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0) perror("setrlimit");
 }
 
-/* ---------- player management ---------- */
+/* ---------- accepting ---------- */
 
-static int count_active(PlayerConn *players) {
-    int c = 0;
-    for (int i = 0; i < MAX_PLAYERS; i++)
-        if (players[i].active) c++;
-    return c;
+static void hand_off(Shard *shards, int nshards, PendingConn *p) {
+    if (shard_submit(pick_shard(shards, nshards), p) < 0) {
+        send_simple(p->fd, OP_SERVER_FULL);
+        close(p->fd);
+    }
 }
 
-/* Accept as many pending connections as possible, non-blocking using select() */
-static void accept_new_players(int listen_fd, PlayerConn *players) {
+static void accept_loop(int listen_fd, Shard *shards, int nshards) {
     while (1) {
-        fd_set rfds;
-        FD_ZERO(&rfds);
-        FD_SET(listen_fd, &rfds);
-
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
-
-        int rv = select(listen_fd + 1, &rfds, NULL, NULL, &tv);
-        if (rv <= 0) {
-            // no more pending connections
-            break;
-        }
-
-        struct sockaddr_in cliaddr;
-        socklen_t clen = sizeof(cliaddr);
-        int cfd = accept(listen_fd, (struct sockaddr *)&cliaddr, &clen);
-        if (cfd < 0) {
+        PendingConn p;
+        socklen_t clen = sizeof(p.addr);
+        p.local = 0;
+        p.fd = accept(listen_fd, (struct sockaddr *)&p.addr, &clen);
+        if (p.fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
             perror("accept");
             break;
         }
-
-        int placed = 0;
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (!players[i].active) {
-                players[i].socket_fd = cfd;
-                players[i].active = 1;
-                hand_init(&players[i].hand);
-                char ipbuf[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &cliaddr.sin_addr, ipbuf, sizeof(ipbuf));
-                printf("Player %d connected from %s:%d\n",
-                       i + 1, ipbuf, ntohs(cliaddr.sin_port));
-                sendf(cfd, "WELCOME Player %d\n", i + 1);
-                placed = 1;
-                break;
-            }
-        }
-
-        if (!placed) {
-            sendf(cfd, "SERVER_FULL\n");
-            close(cfd);
-        }
-    }
-}
-
-/* Blocking wait until at least one player is connected */
-static void wait_for_first_player(int listen_fd, PlayerConn *players) {
-    while (count_active(players) == 0) {
-        printf("Waiting for players...\n");
-        struct sockaddr_in cliaddr;
-        socklen_t clen = sizeof(cliaddr);
-        int cfd = accept(listen_fd, (struct sockaddr *)&cliaddr, &clen);
-        if (cfd < 0) {
-            perror("accept");
-            continue;
-        }
-
-        // put into first free slot
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (!players[i].active) {
-                players[i].socket_fd = cfd;
-                players[i].active = 1;
-                hand_init(&players[i].hand);
-                char ipbuf[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &cliaddr.sin_addr, ipbuf, sizeof(ipbuf));
-                printf("Player %d connected from %s:%d\n",
-                       i + 1, ipbuf, ntohs(cliaddr.sin_port));
-                sendf(cfd, "WELCOME Player %d\n", i + 1);
-                break;
-            }
-        }
-        // After the first one, we'll grab any additional queued ones
-        accept_new_players(listen_fd, players);
-    }
-}
-
-/* ---------- game helpers ---------- */
-
-static void send_initial_hands(PlayerConn *players, Hand *dealer) {
-    char handbuf[256];
-    char cardbuf[16];
-
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!players[i].active) continue;
-        hand_to_string(&players[i].hand, handbuf, sizeof(handbuf));
-        card_to_string(&dealer->cards[0], cardbuf, sizeof(cardbuf));
-        sendf(players[i].socket_fd, "DEALER_UP %s\n", cardbuf);
-        sendf(players[i].socket_fd, "YOUR_HAND %s\n", handbuf);
+        hand_off(shards, nshards, &p);
     }
 }
 
-static void handle_player_turn(PlayerConn *player, Hand *dealer, Deck *deck) {
-    char line[BUFFER_SIZE];
-    char handbuf[256], cardbuf[16];
-
-    if (hand_is_blackjack(&player->hand)) {
-        sendf(player->socket_fd, "BLACKJACK\n");
-        return;
-    }
+/* One multishot accept: a burst of connections comes back from a single
+ * io_uring_enter(). 0 if the ring can't be used, so the caller falls back. */
+static int accept_loop_uring(int listen_fd, Shard *shards, int nshards) {
+    Uring ring;
+    if (uring_init(&ring, 64, 0, 0) < 0) return 0;
 
+    int armed = 0, accepted = 0;
     while (1) {
-        hand_to_string(&player->hand, handbuf, sizeof(handbuf));
-        sendf(player->socket_fd, "YOUR_TURN\n");
-        sendf(player->socket_fd, "HAND %s\n", handbuf);
-        sendf(player->socket_fd, "PROMPT HIT or STAND\n");
-
-        int r = recv_line(player->socket_fd, line, sizeof(line));
-        if (r <= 0) {
-            // disconnected during turn
-            close(player->socket_fd);
-            player->socket_fd = -1;
-            player->active = 0;
-            printf("Player disconnected during turn.\n");
-            return;
+        if (!armed) {
+            struct io_uring_sqe *sqe = uring_sqe(&ring);
+            if (!sqe) break;
+            uring_prep_accept_multishot(sqe, listen_fd, 0);
+            armed = 1;
         }
-        trim_newline(line);
-        for (char *p = line; *p; ++p) {
-            *p = (char)toupper((unsigned char)*p);
+        if (uring_wait(&ring, -1) < 0) {
+            perror("io_uring_enter");
+            break;
         }
-
-        if (strcmp(line, "HIT") == 0) {
-            Card c = deck_deal(deck);
-            hand_add_card(&player->hand, c);
-            card_to_string(&c, cardbuf, sizeof(cardbuf));
-            sendf(player->socket_fd, "HIT %s\n", cardbuf);
-
-            if (hand_is_bust(&player->hand)) {
-                sendf(player->socket_fd, "BUST %d\n", hand_value(&player->hand));
-                break;
-            }
-            if (hand_value(&player->hand) == 21) {
-                sendf(player->socket_fd, "STAND 21\n");
-                break;
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek(&ring))) {
+            int res = cqe->res;
+            if (!(cqe->flags & IORING_CQE_F_MORE)) armed = 0;
+            uring_seen(&ring);
+            if (res >= 0) {
+                PendingConn p;
+                memset(&p, 0, sizeof(p));   // the shard looks the address up
+                p.fd = res;
+                hand_off(shards, nshards, &p);
+                accepted++;
+            } else if (res == -EINVAL && accepted == 0) {
+                uring_close(&ring);   // no multishot accept on this kernel
+                return 0;
+            } else if (res != -EINTR && res != -ECONNABORTED) {
+                fprintf(stderr, "accept: %s\n", strerror(-res));
             }
-            // otherwise loop again
-        } else if (strcmp(line, "STAND") == 0) {
-            sendf(player->socket_fd, "STAND %d\n", hand_value(&player->hand));
-            break;
-        } else {
-            sendf(player->socket_fd, "UNKNOWN_COMMAND\n");
         }
     }
+    uring_close(&ring);
+    return 1;
 }
 
-static void play_dealer_hand(Hand *dealer, Deck *deck) {
-    while (hand_value(dealer) < 17) {
-        hand_add_card(dealer, deck_deal(deck));
-    }
-}
-
-static void send_results(PlayerConn *players, Hand *dealer) {
-    char dealer_str[256];
-    char handbuf[256];
-    hand_to_string(dealer, dealer_str, sizeof(dealer_str));
-    int dealer_val = hand_value(dealer);
-
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!players[i].active) continue;
-        int fd = players[i].socket_fd;
-
-        hand_to_string(&players[i].hand, handbuf, sizeof(handbuf));
-        int pv = hand_value(&players[i].hand);
-
-        sendf(fd, "DEALER_HAND %s\n", dealer_str);
-        sendf(fd, "DEALER_VALUE %d\n", dealer_val);
-        sendf(fd, "PLAYER_VALUE %d\n", pv);
+/* Bots on this host, on their own thread: the shard that seats one sets up
+ * its shared-memory channel */
+typedef struct {
+    int fd;
+    Shard *shards;
+    int nshards;
+} LocalListener;
 
-        if (pv > 21) {
-            sendf(fd, "RESULT LOSE\n");
-        } else if (dealer_val > 21) {
-            sendf(fd, "RESULT WIN\n");
-        } else if (pv > dealer_val) {
-            sendf(fd, "RESULT WIN\n");
-        } else if (pv < dealer_val) {
-            sendf(fd, "RESULT LOSE\n");
-        } else {
-            sendf(fd, "RESULT PUSH\n");
+static void *local_accept_main(void *arg) {
+    LocalListener *l = arg;
+    while (1) {
+        PendingConn p;
+        memset(&p, 0, sizeof(p));
+        p.local = 1;
+        p.fd = accept(l->fd, NULL, NULL);
+        if (p.fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
         }
-
-        // mark end of this round for the client
-        sendf(fd, "ROUND_END\n");
+        hand_off(l->shards, l->nshards, &p);
     }
+    close(l->fd);
+    return NULL;
 }
 
-/* Play one full round with all currently active players */
-static void play_round(PlayerConn *players, int listen_fd) {
-    // fresh deck and dealer hand every round
-    Deck deck;
-    deck_init(&deck);
-    deck_shuffle(&deck);
-
-    Hand dealer;
-    hand_init(&dealer);
-
-    // reset all player hands
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (players[i].active) {
-            hand_init(&players[i].hand);
-        }
-    }
-
-    // initial deal: 2 cards each active player, 2 to dealer
-    for (int r = 0; r < 2; r++) {
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (!players[i].active) continue;
-            Card c = deck_deal(&deck);
-            hand_add_card(&players[i].hand, c);
-        }
-        Card dc = deck_deal(&deck);
-        hand_add_card(&dealer, dc);
-    }
-
-    send_initial_hands(players, &dealer);
-
-    // each player takes a turn
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!players[i].active) continue;
-        handle_player_turn(&players[i], &dealer, &deck);
+static int serve_local(const char *path, int backlog, Shard *shards, int nshards) {
+    static LocalListener l;
+    l.fd = shm_listen(path, backlog);
+    if (l.fd < 0) return -1;
+    l.shards = shards;
+    l.nshards = nshards;
+
+    pthread_t th;
+    int rc = pthread_create(&th, NULL, local_accept_main, &l);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+        close(l.fd);
+        return -1;
     }
-
-    // dealer then plays
-    play_dealer_hand(&dealer, &deck);
-
-    // send results to everyone
-    send_results(players, &dealer);
-
-    printf("Round finished.\n");
+    pthread_detach(th);
+    return 0;
 }
 
 /* ---------- main ---------- */
 
 int main(int argc, char *argv[]) {
     int port = 12345;
-    if (argc >= 2) port = atoi(argv[1]);
+    int nthreads = 1;
+    uint64_t seed = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getpid();
+    int nshufflers = 1;
+    const char *stats_path = NULL;
+    const char *shm_path = NULL;
+    const char *journal_path = NULL;
+    int journal_sync_ms = 10;
+    int backlog = SOMAXCONN;   // the kernel caps it at net.core.somaxconn
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--decks") == 0 && i + 1 < argc) {
+            table_decks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--penetration") == 0 && i + 1 < argc) {
+            table_penetration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--shufflers") == 0 && i + 1 < argc) {
+            nshufflers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--turn-timeout") == 0 && i + 1 < argc) {
+            table_turn_timeout_ms = (int)(atof(argv[++i]) * 1000.0);
+        } else if (strcmp(argv[i], "--idle-turns") == 0 && i + 1 < argc) {
+            table_idle_turns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lobby-wait") == 0 && i + 1 < argc) {
+            table_lobby_wait_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stall-timeout") == 0 && i + 1 < argc) {
+            conn_stall_timeout_ms = (int)(atof(argv[++i]) * 1000.0);
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+            const char *io = argv[++i];
+            if (strcmp(io, "uring") == 0) shard_use_uring = 1;
+            else if (strcmp(io, "epoll") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--backlog") == 0 && i + 1 < argc) {
+            backlog = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stats-socket") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (strcmp(argv[i], "--shm-socket") == 0 && i + 1 < argc) {
+            shm_path = argv[++i];
+        } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+            journal_path = argv[++i];
+        } else if (strcmp(argv[i], "--journal-sync-ms") == 0 && i + 1 < argc) {
+            journal_sync_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cork") == 0) {
+            conn_use_cork = 1;
+        } else if (argv[i][0] != '-') {
+            port = atoi(argv[i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+    if (backlog < 1) backlog = SOMAXCONN;
+    if (journal_sync_ms < 0) journal_sync_ms = 0;
+    raise_fd_limit();
+
+    // every table builds its shoe from these, so reject a bad shape up front
+    if (table_decks < 1 || table_decks > SHOE_MAX_DECKS ||
+        !(table_penetration > 0.0 && table_penetration <= 1.0)) {
+        usage(argv[0]);
+        return 1;
+    }
 
     int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (listen_fd < 0) {
@@ -332,53 +263,70 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    if (listen(listen_fd, MAX_PLAYERS) < 0) {
+    if (listen(listen_fd, backlog) < 0) {
         perror("listen");
         close(listen_fd);
         return 1;
     }
 
-    printf("Blackjack dealer listening on port %d\n", port);
-
-    PlayerConn players[MAX_PLAYERS];
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        players[i].socket_fd = -1;
-        players[i].active    = 0;
-        hand_init(&players[i].hand);
+    // next shoes are shuffled off the deal path; --shufflers 0 keeps it inline
+    static ShoePool shoe_pool;
+    if (nshufflers > 0) {
+        if (shoe_pool_init(&shoe_pool, nshufflers) < 0) {
+            close(listen_fd);
+            return 1;
+        }
+        table_shoe_pool = &shoe_pool;
     }
 
-    while (1) {
-        if (count_active(players) == 0) {
-            // Wait (blocking) for the first player to join
-            wait_for_first_player(listen_fd, players);
+    // rounds are recorded from the first one dealt
+    static Journal journal;
+    if (journal_path) {
+        if (journal_open(&journal, journal_path, journal_sync_ms) < 0) {
+            close(listen_fd);
+            return 1;
         }
+        table_journal = &journal;
+    }
 
-        // Accept any extra players that connected since last round
-        accept_new_players(listen_fd, players);
-
-        if (count_active(players) == 0) {
-            // Could happen if they disconnected very quickly
-            continue;
+    Shard *shards = calloc((size_t)nthreads, sizeof(*shards));
+    if (!shards) {
+        perror("calloc");
+        close(listen_fd);
+        return 1;
+    }
+    // one independent stream per shard; the same --seed replays the same tables
+    Rng master;
+    rng_seed(&master, RNG_DEFAULT, seed);
+    for (int i = 0; i < nthreads; i++) {
+        Rng stream;
+        rng_split(&master, &stream);
+        if (shard_init(&shards[i], i, shards, nthreads, &stream) < 0 ||
+            shard_start(&shards[i]) < 0) {
+            close(listen_fd);
+            return 1;
         }
+    }
+    if (stats_path && stats_serve(stats_path) < 0) {
+        close(listen_fd);
+        return 1;
+    }
+    if (shm_path && serve_local(shm_path, backlog, shards, nthreads) < 0) {
+        close(listen_fd);
+        return 1;
+    }
 
-        play_round(players, listen_fd);
-
-        if (count_active(players) == 0) {
-            printf("All players left. Shutting down.\n");
-            break;
-        }
+    printf("Blackjack dealer listening on port %d (%d worker thread%s on %s, seed %llu, "
+           "%d-deck shoe cut at %.0f%%)\n",
+           port, nthreads, nthreads == 1 ? "" : "s", shard_use_uring ? "io_uring" : "epoll",
+           (unsigned long long)seed, table_decks, table_penetration * 100.0);
+    if (shm_path) printf("Local bots connect on %s (shared memory)\n", shm_path);
+    if (journal_path)
+        printf("Rounds journaled to %s (synced every %d ms)\n", journal_path, journal_sync_ms);
 
-        // Loop again for next round. New players that connected during
-        // the round will be accepted at the top of the loop.
-    }
+    if (!shard_use_uring || !accept_loop_uring(listen_fd, shards, nthreads))
+        accept_loop(listen_fd, shards, nthreads);
 
-    // Clean up
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (players[i].active && players[i].socket_fd >= 0) {
-            close(players[i].socket_fd);
-        }
-    }
     close(listen_fd);
     return 0;
 }
-
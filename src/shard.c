@@ -0,0 +1,544 @@
+#include "../include/shard.h"
+#include "../include/shm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define MAX_EVENTS 256
+
+/* io_uring: requests in flight, and provided receive buffers of RXBUF_SIZE */
+#define RING_ENTRIES 4096
+#define RING_BUFS    1024
+
+/* user_data of the ring's poll on the epoll fd; never a tagged PlayerConn */
+#define IO_EPOLL 4
+
+int shard_use_uring = 0;
+
+/* Only steal from a peer whose backlog is at least this deep */
+#define STEAL_MIN_DEPTH 2
+
+static int next_table_id = 0;
+
+/* ---------- run queue ---------- */
+
+static void schedule_table(Shard *s, Table *t) {
+    if (t->queued) return;
+    t->queued = 1;
+    t->next_run = NULL;
+    if (s->run_tail) s->run_tail->next_run = t;
+    else s->run_head = t;
+    s->run_tail = t;
+}
+
+/* A finished round, or a first player at an idle table: deal now, or once
+ * the lobby wait has given others a chance to sit down */
+static void queue_round(Shard *s, Table *t) {
+    if (table_lobby_wait_ms <= 0) {
+        schedule_table(s, t);
+        return;
+    }
+    if (!timer_armed(&t->lobby))
+        timer_arm(&s->timers, &t->lobby, timer_now_ms() + (uint64_t)table_lobby_wait_ms);
+}
+
+/* A table about to deal to almost nobody sends its players to a fuller one */
+static void consolidate(Shard *s, Table *t) {
+    Table *to;
+    while (t->seated && (to = lobby_merge_target(&s->lobby, t))) {
+        PlayerConn *pc = t->seats[__builtin_ctz(t->seated)];
+        int from = pc->seat;
+        table_remove_player(t, pc);
+        int seat = table_seat_player(to, pc);
+        printf("Player %d moved from table %d to table %d as player %d.\n",
+               from + 1, t->id, to->id, seat + 1);
+        conn_send_int(pc, OP_WELCOME, seat + 1);
+        conn_flush(pc);
+        queue_round(s, to);
+    }
+}
+
+/* Run only the tables queued before this call, so a table whose rounds need
+ * no input (every seat dealt a blackjack) can't starve the socket events. */
+static void run_ready_tables(Shard *s) {
+    Table *t = s->run_head;
+    s->run_head = s->run_tail = NULL;
+    while (t) {
+        Table *next = t->next_run;
+        t->queued = 0;
+        t->next_run = NULL;
+        if (t->state == TABLE_IDLE) consolidate(s, t);
+        if (table_advance(t)) queue_round(s, t);
+        t = next;
+    }
+}
+
+/* ---------- timers ---------- */
+
+static void lobby_expired(Timer *tm, void *ctx) {
+    Table *t = (Table *)((char *)tm - offsetof(Table, lobby));
+    schedule_table(ctx, t);
+}
+
+static void turn_expired(Timer *tm, void *ctx) {
+    Shard *s = ctx;
+    PlayerConn *pc = (PlayerConn *)((char *)tm - offsetof(PlayerConn, deadline));
+    Table *t = pc->table;
+    if (!t) return;
+
+    table_expire_turn(t, pc);
+    if (table_idle_turns > 0 && pc->missed_turns >= table_idle_turns) {
+        printf("Player %d dropped from table %d after %d missed turns.\n",
+               pc->seat + 1, t->id, pc->missed_turns);
+        conn_flush(pc);
+        table_remove_player(t, pc);
+        conn_retire(pc);
+    }
+    if (table_advance(t)) queue_round(s, t);
+}
+
+/* A slow reader's backlog went over budget, or stopped draining */
+static void stall_expired(Timer *tm, void *ctx) {
+    Shard *s = ctx;
+    PlayerConn *pc = (PlayerConn *)((char *)tm - offsetof(PlayerConn, stall));
+    Table *t = pc->table;
+    if (!pc->active) return;
+
+    stats_count(STAT_EVICTIONS, 1);
+    const char *why = pc->evict ? "output over budget" : "not reading";
+    if (!t) printf("Evicted a connection (%s).\n", why);
+    else if (pc->watch) printf("Spectator evicted from table %d (%s).\n", t->id, why);
+    else printf("Player %d evicted from table %d (%s).\n", pc->seat + 1, t->id, why);
+    if (t && pc->watch) table_remove_spectator(t, pc);
+    else if (t) table_remove_player(t, pc);
+    conn_retire(pc);
+
+    // an evicted acting player hands the turn on
+    if (t && t->state == TABLE_AWAITING_DECISION && table_advance(t)) queue_round(s, t);
+}
+
+/* ---------- player management ---------- */
+
+static Table *find_open_table(Shard *s) {
+    Table *open = lobby_place(&s->lobby);
+    if (open) return open;
+
+    if (s->table_count == s->table_cap) {
+        int ncap = s->table_cap ? s->table_cap * 2 : 16;
+        Table **nt = realloc(s->tables, (size_t)ncap * sizeof(*nt));
+        if (!nt) return NULL;
+        s->tables = nt;
+        s->table_cap = ncap;
+    }
+    Table *t = malloc(sizeof(*t));
+    if (!t) return NULL;
+    int id = __atomic_add_fetch(&next_table_id, 1, __ATOMIC_RELAXED);
+    table_init(t, id, rng_next64(&s->rng));
+    t->timers = &s->timers;
+    timer_init(&t->lobby, lobby_expired);
+    lobby_add(&s->lobby, t);
+    s->tables[s->table_count++] = t;
+    return t;
+}
+
+static void seat_connection(Shard *s, const PendingConn *p) {
+    int cfd = p->fd;
+    Table *t = find_open_table(s);
+    PlayerConn *pc = t ? conn_new() : NULL;
+    if (!pc) {
+        send_simple(cfd, OP_SERVER_FULL);
+        close(cfd);
+        return;
+    }
+    pc->socket_fd = cfd;
+    pc->active = 1;
+    rxbuf_init(&pc->rx);
+    timer_init(&pc->deadline, turn_expired);
+    timer_init(&pc->stall, stall_expired);
+
+    struct epoll_event ev;
+    ev.data.ptr = pc;
+    int rc;
+    if (p->local) {
+        // a bot on this host: its messages come and go through shared
+        // memory, its doorbell says there are some (or room for ours), and
+        // the socket is left only to report that it hung up
+        if (conn_attach_shm(pc) < 0) {
+            perror("shm channel");
+            close(cfd);
+            conn_free(pc);
+            return;
+        }
+        ev.events = EPOLLIN | EPOLLET;
+        rc = epoll_ctl(s->epfd, EPOLL_CTL_ADD, pc->shm->bell, &ev);
+        ev.events = EPOLLRDHUP | EPOLLET;
+        if (rc == 0) rc = epoll_ctl(s->epfd, EPOLL_CTL_ADD, cfd, &ev);
+    } else {
+        // a fixed kernel buffer rather than an autotuned one of megabytes, so
+        // a reader who stops shows up in our bounded backlog within seconds
+        int sndbuf = CONN_TX_HIGH;
+        setsockopt(cfd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+        // EPOLLOUT only matters once a socket fills up and output is queued
+        // behind it; edge-triggered, it fires once now and then only on a
+        // drain. With a ring, input comes by completion; epoll still reports
+        // hangups, which a receive held back for a full rx would not.
+        ev.events = (s->ring ? 0 : EPOLLIN) | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        rc = epoll_ctl(s->epfd, EPOLL_CTL_ADD, cfd, &ev);
+    }
+    if (rc < 0) {
+        perror("epoll_ctl");
+        close(cfd);
+        conn_free(pc);
+        return;
+    }
+    __atomic_add_fetch(&s->conn_count, 1, __ATOMIC_RELAXED);
+    stats_count(STAT_CONNECTS, 1);
+    if (s->ring && !pc->shm && conn_start_recv(pc) < 0) {
+        fprintf(stderr, "Shard %d: io_uring queue full, dropping a connection\n", s->id);
+        conn_retire(pc);
+        return;
+    }
+
+    int seat = table_seat_player(t, pc);
+    if (pc->shm) {
+        printf("Player %d connected to table %d (shard %d) over shared memory\n",
+               seat + 1, t->id, s->id);
+    } else {
+        struct sockaddr_in addr = p->addr;
+        if (addr.sin_family == 0) {   // a multishot accept doesn't report it
+            socklen_t alen = sizeof(addr);
+            getpeername(cfd, (struct sockaddr *)&addr, &alen);
+        }
+        char ipbuf[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.sin_addr, ipbuf, sizeof(ipbuf));
+        printf("Player %d connected to table %d (shard %d) from %s:%d\n",
+               seat + 1, t->id, s->id, ipbuf, ntohs(addr.sin_port));
+    }
+    conn_send_int(pc, OP_WELCOME, seat + 1);
+
+    // an idle table dealing right away sends the greeting with the first deal
+    if (t->state == TABLE_IDLE) queue_round(s, t);
+    if (t->state != TABLE_IDLE || !t->queued) conn_flush(pc);
+}
+
+static int drain_incoming(Shard *s) {
+    PendingConn p;
+    int n = 0;
+    while (connq_pop(&s->incoming, &p) == 0) {
+        seat_connection(s, &p);
+        n++;
+    }
+    return n;
+}
+
+/* An idle shard takes half of the deepest peer backlog */
+static int steal_work(Shard *s) {
+    Shard *victim = NULL;
+    size_t best = STEAL_MIN_DEPTH - 1;
+    for (int i = 0; i < s->npeers; i++) {
+        Shard *p = &s->peers[i];
+        if (p == s) continue;
+        size_t d = connq_depth(&p->incoming);
+        if (d > best) {
+            best = d;
+            victim = p;
+        }
+    }
+    if (!victim) return 0;
+
+    PendingConn p;
+    int n = 0;
+    size_t want = (best + 1) / 2;
+    while ((size_t)n < want && connq_pop(&victim->incoming, &p) == 0) {
+        seat_connection(s, &p);
+        n++;
+    }
+    return n;
+}
+
+static void handle_spectator_event(PlayerConn *pc, uint32_t events) {
+    Table *t = pc->table;
+    int gone = (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+    if (!gone && (events & EPOLLIN)) gone = conn_discard_input(pc) < 0;
+    if (!gone && (events & EPOLLOUT)) gone = watch_flush(pc->watch, pc->socket_fd) < 0;
+    if (gone) {
+        printf("Spectator left table %d.\n", t->id);
+        table_remove_spectator(t, pc);
+        conn_retire(pc);
+    }
+}
+
+static void handle_player_event(Shard *s, PlayerConn *pc, uint32_t events) {
+    Table *t = pc->table;
+    if (!pc->active || !t) return;
+
+    // a local bot's doorbell means input, or room for our output; its
+    // socket only ever reports the hangup
+    if (pc->shm) {
+        if (events & EPOLLIN) events |= EPOLLOUT;
+        if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) pc->rx_closed = 1;
+    }
+
+    // room again for a slow reader; back under the low-water mark they are
+    // dealt in again (a failed send shows up as a hangup below)
+    if ((events & EPOLLOUT) && pc->backlog_len) {
+        int was_congested = pc->congested;
+        conn_drain(pc);
+        if (was_congested && !pc->congested && t->state == TABLE_IDLE) queue_round(s, t);
+    }
+    if (pc->watch) {
+        handle_spectator_event(pc, events);
+        return;
+    }
+
+    // the acting player: feed the table, which also notices a disconnect
+    if (t->state == TABLE_AWAITING_DECISION && t->turn == pc->seat &&
+        pc->state == PLAYER_DECIDING) {
+        if (table_advance(t)) queue_round(s, t);
+        return;
+    }
+
+    // anyone else only gets control messages (PROTO) handled now; a
+    // decision stays queued until their turn
+    int r = conn_pump(pc);
+    if (r < 0 || (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        printf("Player %d left table %d.\n", pc->seat + 1, t->id);
+        table_remove_player(t, pc);
+        conn_retire(pc);
+    } else if (r == 1) {
+        table_watch(t, pc);
+    }
+}
+
+/* ---------- event loop ---------- */
+
+static int next_timeout(Shard *s) {
+    int timeout = timer_wheel_timeout(&s->timers, timer_now_ms());
+    if (s->run_head || connq_depth(&s->incoming) > 0) timeout = 0;
+    return timeout;
+}
+
+/* Returns 1 if the wake-up eventfd was among them */
+static int dispatch_epoll(Shard *s, const struct epoll_event *events, int n) {
+    int woken = 0;
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.ptr == s) {
+            uint64_t v;
+            if (read(s->wake_fd, &v, sizeof(v)) < 0 && errno != EAGAIN)
+                perror("read eventfd");
+            woken = 1;
+        } else {
+            handle_player_event(s, events[i].data.ptr, events[i].events);
+        }
+    }
+    return woken;
+}
+
+/* Everything after a wait: seat newcomers, fire timers, deal, free */
+static void after_wait(Shard *s, int woken) {
+    if (drain_incoming(s) == 0 && woken) steal_work(s);
+
+    timer_wheel_run(&s->timers, timer_now_ms(), s);
+    run_ready_tables(s);
+
+    int freed = conn_reap();
+    if (freed) __atomic_sub_fetch(&s->conn_count, freed, __ATOMIC_RELAXED);
+}
+
+static void run_epoll(Shard *s) {
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int timeout = next_timeout(s);
+        __atomic_store_n(&s->idle, timeout != 0, __ATOMIC_RELAXED);
+        int n = epoll_wait(s->epfd, events, MAX_EVENTS, timeout);
+        __atomic_store_n(&s->idle, 0, __ATOMIC_RELAXED);
+        stats_count(STAT_POLLS, 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        after_wait(s, dispatch_epoll(s, events, n));
+    }
+}
+
+/* ---------- io_uring event loop ---------- */
+
+/* The epoll fd, read through the ring: wake-ups and spectators' EPOLLOUT */
+static int poll_epoll(Shard *s) {
+    struct io_uring_sqe *sqe = uring_sqe(s->ring);
+    if (!sqe) return -1;
+    uring_prep_poll_multishot(sqe, s->epfd, POLLIN, IO_EPOLL);
+    return 0;
+}
+
+static Uring *open_ring(Shard *s) {
+    Uring *u = malloc(sizeof(*u));
+    if (!u) return NULL;
+    if (uring_init(u, RING_ENTRIES, RING_BUFS, RXBUF_SIZE) < 0) {
+        fprintf(stderr, "Shard %d: io_uring unavailable (%s), using epoll\n",
+                s->id, strerror(errno));
+        free(u);
+        return NULL;
+    }
+    s->ring = u;
+    if (poll_epoll(s) < 0) {
+        uring_close(u);
+        free(u);
+        s->ring = NULL;
+        return NULL;
+    }
+    conn_set_ring(u);
+    return u;
+}
+
+static void ring_completion(Shard *s, PlayerConn *pc, uint64_t kind, int res, unsigned flags) {
+    if (kind == CONN_IO_RECV) {
+        int r = conn_recv_done(pc, res, flags);
+        if (r) handle_player_event(s, pc, r > 0 ? EPOLLIN : EPOLLIN | EPOLLRDHUP);
+        return;
+    }
+
+    int was_congested = pc->congested;
+    if (conn_send_done(pc, res) < 0) {
+        handle_player_event(s, pc, EPOLLIN | EPOLLRDHUP);
+        return;
+    }
+    // back under the low-water mark they are dealt in again
+    Table *t = pc->table;
+    if (pc->active && t && was_congested && !pc->congested && t->state == TABLE_IDLE)
+        queue_round(s, t);
+}
+
+static void run_uring(Shard *s) {
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int timeout = next_timeout(s);
+        conn_resume_recvs();
+        conn_submit_sends();
+        __atomic_store_n(&s->idle, timeout != 0, __ATOMIC_RELAXED);
+        int rc = uring_wait(s->ring, timeout);
+        __atomic_store_n(&s->idle, 0, __ATOMIC_RELAXED);
+        stats_count(STAT_POLLS, 1);
+        if (rc < 0) {
+            perror("io_uring_enter");
+            break;
+        }
+
+        int woken = 0;
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek(s->ring))) {
+            uint64_t ud = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            uring_seen(s->ring);
+
+            if (ud == IO_EPOLL) {
+                int n;
+                do {
+                    n = epoll_wait(s->epfd, events, MAX_EVENTS, 0);
+                    if (n > 0) woken |= dispatch_epoll(s, events, n);
+                } while (n == MAX_EVENTS);
+                if (!(flags & IORING_CQE_F_MORE)) poll_epoll(s);
+            } else if (ud != CONN_IO_NONE) {
+                ring_completion(s, (PlayerConn *)(uintptr_t)(ud & ~(uint64_t)CONN_IO_MASK),
+                                ud & CONN_IO_MASK, res, flags);
+            }
+        }
+        after_wait(s, woken);
+    }
+}
+
+static void *shard_main(void *arg) {
+    Shard *s = arg;
+    stats_local = &s->stats;
+    conn_set_timers(&s->timers);
+    conn_set_pool(&s->sessions);
+
+    // the ring is this thread's, so it is set up here rather than in shard_init
+    if (shard_use_uring && open_ring(s)) run_uring(s);
+    else run_epoll(s);
+    return NULL;
+}
+
+/* ---------- setup / accept-thread side ---------- */
+
+int shard_init(Shard *s, int id, Shard *peers, int npeers, const Rng *rng) {
+    memset(s, 0, sizeof(*s));
+    s->id = id;
+    s->peers = peers;
+    s->npeers = npeers;
+    s->rng = *rng;
+    timer_wheel_init(&s->timers, timer_now_ms());
+    lobby_init(&s->lobby);
+    pool_init(&s->sessions, sizeof(PlayerConn));
+    stats_register(&s->stats);
+
+    if (connq_init(&s->incoming, SHARD_QUEUE_SIZE) < 0) return -1;
+
+    s->epfd = epoll_create1(0);
+    if (s->epfd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+    s->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (s->wake_fd < 0) {
+        perror("eventfd");
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = s;   // the shard itself marks its wake-up eventfd
+    if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, s->wake_fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+int shard_start(Shard *s) {
+    int rc = pthread_create(&s->thread, NULL, shard_main, s);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+        return -1;
+    }
+    return 0;
+}
+
+void shard_wake(Shard *s) {
+    uint64_t one = 1;
+    if (write(s->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        perror("write eventfd");
+}
+
+int shard_submit(Shard *s, const PendingConn *pc) {
+    if (connq_push(&s->incoming, pc) < 0) return -1;
+    shard_wake(s);
+
+    // the target is falling behind: nudge an idle peer to come and steal
+    if (connq_depth(&s->incoming) >= STEAL_MIN_DEPTH) {
+        for (int i = 0; i < s->npeers; i++) {
+            Shard *p = &s->peers[i];
+            if (p != s && __atomic_load_n(&p->idle, __ATOMIC_RELAXED)) {
+                shard_wake(p);
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+int shard_load(const Shard *s) {
+    return __atomic_load_n(&s->conn_count, __ATOMIC_RELAXED) +
+           (int)connq_depth(&s->incoming);
+}
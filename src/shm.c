@@ -0,0 +1,235 @@
+#include "../include/shm.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/memfd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+#define RING_MASK (SHM_RING_SIZE - 1)
+
+/* Sent with the channel, in this order: the segment, the bot's doorbell,
+ * the server's */
+#define SHM_FDS 3
+
+/* ---------- setup ---------- */
+
+int shm_listen(const char *path, int backlog) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "shm socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);   // a stale socket from a previous run
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0) {
+        perror("shm socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int send_fds(int sock, const int *fds) {
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr h;
+        char buf[CMSG_SPACE(SHM_FDS * sizeof(int))];
+    } ctl;
+    memset(&ctl, 0, sizeof(ctl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(SHM_FDS * sizeof(int));
+    memcpy(CMSG_DATA(c), fds, SHM_FDS * sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1 ? 0 : -1;
+}
+
+/* The descriptors sent with one message; -1 with errno EPROTO if the
+ * message carried none */
+static int recv_fds(int sock, int *fds) {
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr h;
+        char buf[CMSG_SPACE(SHM_FDS * sizeof(int))];
+    } ctl;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return -1;
+    if (n == 0) {
+        errno = ECONNRESET;
+        return -1;
+    }
+
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    if (!c || c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS ||
+        c->cmsg_len != CMSG_LEN(SHM_FDS * sizeof(int))) {
+        errno = EPROTO;   // text instead: the server turned us away
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(c), SHM_FDS * sizeof(int));
+    return 0;
+}
+
+static void link_init(ShmLink *l) {
+    memset(l, 0, sizeof(*l));
+    l->bell = -1;
+    l->peer_bell = -1;
+}
+
+int shm_link_create(ShmLink *l, int sock) {
+    link_init(l);
+    int memfd = (int)syscall(__NR_memfd_create, "blackjack-shm", MFD_CLOEXEC);
+    if (memfd < 0) return -1;
+
+    int rc = -1;
+    if (ftruncate(memfd, sizeof(ShmChannel)) == 0) {
+        l->ch = mmap(NULL, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if (l->ch == MAP_FAILED) l->ch = NULL;
+    }
+    if (l->ch) {
+        // a new memfd reads as zeros: both rings start empty, and both
+        // readers start out waiting to be rung
+        l->ch->up.reader_asleep = 1;
+        l->ch->down.reader_asleep = 1;
+        l->ch->ring_size = SHM_RING_SIZE;
+        l->ch->magic = SHM_MAGIC;
+        l->rx = &l->ch->up;
+        l->tx = &l->ch->down;
+        l->bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        l->peer_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        int fds[SHM_FDS] = { memfd, l->peer_bell, l->bell };
+        if (l->bell >= 0 && l->peer_bell >= 0 && send_fds(sock, fds) == 0) rc = 0;
+    }
+
+    int e = errno;
+    close(memfd);   // the mapping keeps the segment
+    if (rc < 0) shm_link_close(l);
+    errno = e;
+    return rc;
+}
+
+int shm_link_accept(ShmLink *l, int sock) {
+    link_init(l);
+    int fds[SHM_FDS];
+    if (recv_fds(sock, fds) < 0) return -1;
+
+    ShmChannel *ch = mmap(NULL, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    l->bell = fds[1];
+    l->peer_bell = fds[2];
+    if (ch == MAP_FAILED || ch->magic != SHM_MAGIC || ch->ring_size != SHM_RING_SIZE) {
+        if (ch != MAP_FAILED) munmap(ch, sizeof(ShmChannel));
+        shm_link_close(l);
+        errno = EPROTO;
+        return -1;
+    }
+    l->ch = ch;
+    l->rx = &ch->down;
+    l->tx = &ch->up;
+    return 0;
+}
+
+void shm_link_close(ShmLink *l) {
+    if (l->ch) munmap(l->ch, sizeof(ShmChannel));
+    if (l->bell >= 0) close(l->bell);
+    if (l->peer_bell >= 0) close(l->peer_bell);
+    link_init(l);
+}
+
+/* ---------- rings ---------- */
+
+static void ring_bell(int fd) {
+    uint64_t one = 1;
+    if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN) perror("write eventfd");
+}
+
+/* The flags and positions are sequentially consistent: a writer that
+ * publishes and then finds the reader awake can't miss a reader that
+ * declared itself asleep and then found nothing, and likewise for room. */
+static size_t ring_put(ShmRing *r, const char *buf, size_t len) {
+    uint32_t tail = r->tail;
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_SEQ_CST);
+    // the peer can write anything here: a position it can't have reached
+    // leaves no room rather than a copy past the ring
+    uint32_t used = tail - head;
+    size_t room = used > SHM_RING_SIZE ? 0 : SHM_RING_SIZE - used;
+    if (len > room) len = room;
+    if (len == 0) return 0;
+
+    size_t off = tail & RING_MASK;
+    size_t first = SHM_RING_SIZE - off < len ? SHM_RING_SIZE - off : len;
+    memcpy(r->data + off, buf, first);
+    memcpy(r->data, buf + first, len - first);
+    __atomic_store_n(&r->tail, tail + (uint32_t)len, __ATOMIC_SEQ_CST);
+    return len;
+}
+
+size_t shm_send(ShmLink *l, const void *buf, size_t len) {
+    ShmRing *r = l->tx;
+    size_t n = ring_put(r, buf, len);
+    if (n < len) {
+        // full: ask to be rung for room, then look once more
+        __atomic_store_n(&r->writer_blocked, 1, __ATOMIC_SEQ_CST);
+        n += ring_put(r, (const char *)buf + n, len - n);
+    }
+    if (n && __atomic_exchange_n(&r->reader_asleep, 0, __ATOMIC_SEQ_CST))
+        ring_bell(l->peer_bell);
+    return n;
+}
+
+size_t shm_peek(ShmLink *l, const char **p) {
+    ShmRing *r = l->rx;
+    uint32_t head = r->head;
+    size_t n = (size_t)(__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) - head);
+    size_t off = head & RING_MASK;
+    if (n > SHM_RING_SIZE - off) n = SHM_RING_SIZE - off;   // also bounds a bad tail
+    *p = r->data + off;
+    return n;
+}
+
+void shm_consume(ShmLink *l, size_t n) {
+    ShmRing *r = l->rx;
+    if (n == 0) return;
+    __atomic_store_n(&r->head, r->head + (uint32_t)n, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&r->writer_blocked, 0, __ATOMIC_SEQ_CST))
+        ring_bell(l->peer_bell);
+}
+
+int shm_idle(ShmLink *l) {
+    ShmRing *r = l->rx;
+    __atomic_store_n(&r->reader_asleep, 1, __ATOMIC_SEQ_CST);
+    // a write that raced the flag is seen here; the flag may then cost the
+    // writer one needless ring, never a lost one
+    return __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == r->head;
+}
@@ -0,0 +1,205 @@
+#include "../include/shoe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static void shuffle_cards(Rng *rng, Card *cards, int n) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)rng_bounded(rng, (uint32_t)(i + 1));
+        Card tmp = cards[i];
+        cards[i] = cards[j];
+        cards[j] = tmp;
+    }
+}
+
+/* ---------- shoe ---------- */
+
+/* Back to factory order, so a seed alone decides every shuffle that follows */
+static void restart(Shoe *shoe) {
+    for (int d = 0; d < shoe->ndecks; d++) deck_fill(shoe->cards + d * DECK_SIZE);
+    shoe->shuffles = 0;
+    shoe_shuffle(shoe);
+}
+
+static int setup(Shoe *shoe, int ndecks, double penetration) {
+    if (ndecks < 1 || ndecks > SHOE_MAX_DECKS) return -1;
+    if (!(penetration > 0.0 && penetration <= 1.0)) return -1;
+
+    shoe->ndecks = ndecks;
+    shoe->size = ndecks * DECK_SIZE;
+    shoe->cards = shoe->bufs[0];
+    shoe->spare = shoe->bufs[1];
+    shoe->pool = NULL;
+    shoe->next_job = NULL;
+
+    // at least one card must come out before the shoe counts as finished
+    shoe->cut = (int)(shoe->size * penetration);
+    if (shoe->cut < 1) shoe->cut = 1;
+    return 0;
+}
+
+int shoe_init(Shoe *shoe, int ndecks, double penetration) {
+    if (setup(shoe, ndecks, penetration) < 0) return -1;
+
+    /* every shoe gets its own stream so shuffles are safe across threads */
+    static uint64_t shoes_created = 0;
+    uint64_t n = __atomic_fetch_add(&shoes_created, 1, __ATOMIC_RELAXED);
+    shoe_seed(shoe, ((uint64_t)time(NULL) << 32) ^ ((uint64_t)getpid() << 16) ^ n);
+    return 0;
+}
+
+int shoe_init_seeded(Shoe *shoe, int ndecks, double penetration, uint64_t seed) {
+    if (setup(shoe, ndecks, penetration) < 0) return -1;
+    shoe_seed(shoe, seed);
+    return 0;
+}
+
+void shoe_seed(Shoe *shoe, uint64_t seed) {
+    rng_seed(&shoe->rng, RNG_DEFAULT, seed);
+    restart(shoe);
+}
+
+void shoe_set_rng(Shoe *shoe, const Rng *rng) {
+    shoe->rng = *rng;
+    restart(shoe);
+}
+
+static void queue_spare(Shoe *shoe);
+static void claim_spare(Shoe *shoe);
+
+void shoe_shuffle(Shoe *shoe) {
+    if (!shoe->pool) {
+        shuffle_cards(&shoe->rng, shoe->cards, shoe->size);
+    } else {
+        claim_spare(shoe);
+        Card *tmp = shoe->cards;
+        shoe->cards = shoe->spare;
+        shoe->spare = tmp;
+        // the next shoe reshuffles this one, as an inline shuffle would, so
+        // a seed deals the same shoes with or without the pool
+        memcpy(shoe->spare, shoe->cards, (size_t)shoe->size * sizeof(Card));
+        queue_spare(shoe);
+    }
+    shoe->top = 0;
+    shoe->shuffles++;
+}
+
+int shoe_begin_round(Shoe *shoe) {
+    if (shoe->top < shoe->cut) return 0;
+    shoe_shuffle(shoe);
+    return 1;
+}
+
+Card shoe_deal(Shoe *shoe) {
+    if (shoe->top >= shoe->size) {
+        shoe_shuffle(shoe);
+    }
+    return shoe->cards[shoe->top++];
+}
+
+int shoe_remaining(const Shoe *shoe) {
+    return shoe->size - shoe->top;
+}
+
+/* ---------- background shuffling ---------- */
+
+static void queue_spare(Shoe *shoe) {
+    ShoePool *pool = shoe->pool;
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&shoe->spare_state, SPARE_QUEUED, __ATOMIC_RELAXED);
+    shoe->next_job = NULL;
+    if (pool->tail) pool->tail->next_job = shoe;
+    else pool->head = shoe;
+    pool->tail = shoe;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Make sure the spare is shuffled. Normally a shuffler finished long ago;
+ * if not, take the job back and do it here, or wait out the one in flight. */
+static void claim_spare(Shoe *shoe) {
+    ShoePool *pool = shoe->pool;
+    if (__atomic_load_n(&shoe->spare_state, __ATOMIC_ACQUIRE) == SPARE_READY) {
+        __atomic_add_fetch(&pool->stats.swaps, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_add_fetch(&pool->stats.dry, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&pool->lock);
+    if (shoe->spare_state == SPARE_QUEUED) {
+        Shoe **pp = &pool->head;
+        Shoe *prev = NULL;
+        while (*pp != shoe) {
+            prev = *pp;
+            pp = &(*pp)->next_job;
+        }
+        *pp = shoe->next_job;
+        if (pool->tail == shoe) pool->tail = prev;
+        shoe->spare_state = SPARE_SHUFFLING;
+        pthread_mutex_unlock(&pool->lock);
+
+        shuffle_cards(&shoe->rng, shoe->spare, shoe->size);
+        __atomic_store_n(&shoe->spare_state, SPARE_READY, __ATOMIC_RELEASE);
+        return;
+    }
+    while (shoe->spare_state != SPARE_READY)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *shuffler_main(void *arg) {
+    ShoePool *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->head) pthread_cond_wait(&pool->work, &pool->lock);
+        Shoe *shoe = pool->head;
+        pool->head = shoe->next_job;
+        if (!pool->head) pool->tail = NULL;
+        shoe->spare_state = SPARE_SHUFFLING;
+        pthread_mutex_unlock(&pool->lock);
+
+        shuffle_cards(&shoe->rng, shoe->spare, shoe->size);
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_store_n(&shoe->spare_state, SPARE_READY, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&pool->stats.shuffled, 1, __ATOMIC_RELAXED);
+        pthread_cond_broadcast(&pool->done);
+    }
+    return NULL;
+}
+
+int shoe_pool_init(ShoePool *pool, int nthreads) {
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->threads = calloc((size_t)nthreads, sizeof(*pool->threads));
+    if (!pool->threads) {
+        perror("calloc");
+        return -1;
+    }
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, shuffler_main, pool) != 0) {
+            perror("pthread_create");
+            return -1;
+        }
+        pthread_detach(pool->threads[i]);
+        pool->nthreads++;
+    }
+    return 0;
+}
+
+void shoe_attach_pool(Shoe *shoe, ShoePool *pool) {
+    memcpy(shoe->spare, shoe->cards, (size_t)shoe->size * sizeof(Card));
+    shoe->pool = pool;
+    queue_spare(shoe);
+}
+
+void shoe_pool_stats(ShoePool *pool, ShoePoolStats *out) {
+    out->shuffled = __atomic_load_n(&pool->stats.shuffled, __ATOMIC_RELAXED);
+    out->swaps    = __atomic_load_n(&pool->stats.swaps, __ATOMIC_RELAXED);
+    out->dry      = __atomic_load_n(&pool->stats.dry, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,359 @@
+/*
+ * Headless Monte Carlo simulator
+ * Plays hands in-process with the same engine the server uses (shoe.c,
+ * blackjack.c) and reports the player's expected value.
+ *
+ * Usage: ./simulate [--hands N] [--threads T] [--strategy NAME] [--seed S]
+ *                   [--rng xoshiro|pcg] [--decks D] [--penetration P]
+ *                   [--bench-eval]
+ *
+ * Each thread owns its shoe and an independent random stream split off one
+ * master seed, so a run is reproducible; results are merged at the end.
+ * Rules match the server: one seat, the shoe is reshuffled once the cut card
+ * comes out, dealer stands on all 17s, every win pays 1:1.
+ *
+ * --bench-eval instead checks the batched hand kernels (handbatch.c) against
+ * blackjack.c on N dealt hands and times both.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/blackjack.h"
+#include "../include/handbatch.h"
+#include "../include/shoe.h"
+#include "../include/strategy.h"
+
+/* returns 1 to hit, 0 to stand */
+typedef int (*Strategy)(const Hand *player, Card up);
+
+typedef struct {
+    /* inputs */
+    long long hands;
+    int decks;
+    double penetration;
+    Rng rng;
+    Strategy strategy;
+
+    /* results */
+    long long wins, pushes, losses;
+    long long blackjacks, busts;
+    unsigned long shuffles;
+    char pad[64];   /* keep neighbouring threads' counters apart */
+} SimThread;
+
+/* ---------- strategies ---------- */
+
+static int strat_stand(const Hand *player, Card up) {
+    (void)player; (void)up;
+    return 0;
+}
+
+/* mimic the dealer: hit below 17 */
+static int strat_dealer(const Hand *player, Card up) {
+    (void)up;
+    return hand_value(player) < 17;
+}
+
+/* never risk a bust */
+static int strat_never_bust(const Hand *player, Card up) {
+    (void)up;
+    return hand_is_soft(player) ? hand_value(player) < 18 : hand_value(player) < 12;
+}
+
+/* hit/stand basic strategy (no doubling or splitting on this table) */
+static int strat_basic(const Hand *player, Card up) {
+    int v = hand_value(player);
+    int r = card_rank(up);
+    int d = r == 1 ? 11 : (r >= 10 ? 10 : r);
+
+    if (hand_is_soft(player)) {
+        if (v >= 19) return 0;
+        if (v == 18) return d >= 9;
+        return 1;
+    }
+    if (v >= 17) return 0;
+    if (v >= 13) return d >= 7;
+    if (v == 12) return d < 4 || d >= 7;
+    return 1;
+}
+
+/* whatever the server's HINT command would say */
+static int strat_hint(const Hand *player, Card up) {
+    return strategy_hint(player, up) == HINT_HIT;
+}
+
+static const struct {
+    const char *name;
+    Strategy fn;
+} strategies[] = {
+    { "basic",      strat_basic      },
+    { "dealer",     strat_dealer     },
+    { "hint",       strat_hint       },
+    { "never-bust", strat_never_bust },
+    { "stand",      strat_stand      },
+};
+
+/* ---------- simulation ---------- */
+
+static void *sim_main(void *arg) {
+    SimThread *st = arg;
+    Shoe shoe;
+    Hand player, dealer;
+
+    shoe_init(&shoe, st->decks, st->penetration);
+    shoe_set_rng(&shoe, &st->rng);
+
+    long long wins = 0, pushes = 0, losses = 0, blackjacks = 0, busts = 0;
+    for (long long n = 0; n < st->hands; n++) {
+        shoe_begin_round(&shoe);
+        hand_init(&player);
+        hand_init(&dealer);
+
+        // same order as the table: player, dealer, player, dealer
+        hand_add_card(&player, shoe_deal(&shoe));
+        hand_add_card(&dealer, shoe_deal(&shoe));
+        hand_add_card(&player, shoe_deal(&shoe));
+        hand_add_card(&dealer, shoe_deal(&shoe));
+
+        if (hand_is_blackjack(&player)) {
+            blackjacks++;
+        } else {
+            while (hand_value(&player) < 21 && st->strategy(&player, dealer.cards[0]))
+                hand_add_card(&player, shoe_deal(&shoe));
+        }
+
+        if (hand_is_bust(&player)) {
+            busts++;
+            losses++;
+            continue;
+        }
+
+        play_dealer_hand(&dealer, &shoe);
+        int r = hand_outcome(&player, &dealer);
+        if (r > 0) wins++;
+        else if (r < 0) losses++;
+        else pushes++;
+    }
+
+    st->wins = wins;
+    st->pushes = pushes;
+    st->losses = losses;
+    st->blackjacks = blackjacks;
+    st->busts = busts;
+    st->shuffles = shoe.shuffles;
+    return NULL;
+}
+
+/* ---------- batch kernel benchmark ---------- */
+
+#define BENCH_LANES (1 << 16)   /* hands per batch; fits comfortably in L2 */
+
+static double now_sec(void);
+
+/* Deal every lane 2-5 cards both ways, then evaluate both ways and compare */
+static int bench_eval(long long hands, Rng *rng, int decks, double penetration) {
+    static Hand aos[BENCH_LANES];
+    static uint8_t count[BENCH_LANES], hard[BENCH_LANES], aces[BENCH_LANES];
+    static uint8_t value[BENCH_LANES], soft[BENCH_LANES], bust[BENCH_LANES], bj[BENCH_LANES];
+    static uint8_t ref[4][BENCH_LANES];
+    static Card cards[BENCH_LANES];
+    HandBatch batch = { count, hard, aces, BENCH_LANES };
+    HandBatchEval eval = { value, soft, bust, bj };
+    Shoe shoe;
+
+    shoe_init(&shoe, decks, penetration);
+    shoe_set_rng(&shoe, rng);
+
+    double t_scalar = 0.0, t_batch = 0.0;
+    long long mismatches = 0;
+    for (long long done = 0; done < hands; done += BENCH_LANES) {
+        for (int i = 0; i < BENCH_LANES; i++) hand_init(&aos[i]);
+        hand_batch_clear(&batch);
+
+        int rounds = 2 + (int)rng_bounded(rng, 4);
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < BENCH_LANES; i++) cards[i] = shoe_deal(&shoe);
+            shoe_begin_round(&shoe);
+
+            double t0 = now_sec();
+            for (int i = 0; i < BENCH_LANES; i++) hand_add_card(&aos[i], cards[i]);
+            double t1 = now_sec();
+            hand_batch_add(&batch, cards);
+            double t2 = now_sec();
+            t_scalar += t1 - t0;
+            t_batch += t2 - t1;
+        }
+
+        double t0 = now_sec();
+        for (int i = 0; i < BENCH_LANES; i++) {
+            ref[0][i] = (uint8_t)hand_value(&aos[i]);
+            ref[1][i] = (uint8_t)hand_is_soft(&aos[i]);
+            ref[2][i] = (uint8_t)hand_is_bust(&aos[i]);
+            ref[3][i] = (uint8_t)hand_is_blackjack(&aos[i]);
+        }
+        double t1 = now_sec();
+        hand_batch_eval(&batch, &eval);
+        double t2 = now_sec();
+        t_scalar += t1 - t0;
+        t_batch += t2 - t1;
+
+        for (int i = 0; i < BENCH_LANES; i++) {
+            mismatches += count[i] != aos[i].count || hard[i] != aos[i].hard ||
+                          aces[i] != aos[i].aces || value[i] != ref[0][i] ||
+                          soft[i] != ref[1][i] || bust[i] != ref[2][i] || bj[i] != ref[3][i];
+        }
+    }
+
+    long long n = (hands + BENCH_LANES - 1) / BENCH_LANES * BENCH_LANES;
+    printf("kernel        %s\n", hand_batch_kernel());
+    printf("hands         %lld\n", n);
+    printf("scalar        %.3f s (%.1fM hands/sec)\n", t_scalar, (double)n / t_scalar / 1e6);
+    printf("batch         %.3f s (%.1fM hands/sec, %.1fx)\n", t_batch,
+           (double)n / t_batch / 1e6, t_scalar / t_batch);
+    printf("mismatches    %lld\n", mismatches);
+    return mismatches ? 1 : 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--hands N] [--threads T] [--strategy NAME] [--seed S]\n"
+            "          [--rng xoshiro|pcg] [--decks 1-%d] [--penetration 0-1]\n"
+            "          [--bench-eval]\n"
+            "strategies:", prog, SHOE_MAX_DECKS);
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++)
+        fprintf(stderr, " %s", strategies[i].name);
+    fprintf(stderr, "\n");
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    long long hands = 10000000;
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *strategy = "basic";
+    uint64_t seed = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getpid();
+    RngKind kind = RNG_DEFAULT;
+    int decks = SHOE_DEFAULT_DECKS;
+    double penetration = SHOE_DEFAULT_PENETRATION;
+    int bench = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--hands") == 0 && i + 1 < argc) {
+            hands = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nthreads = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            strategy = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--decks") == 0 && i + 1 < argc) {
+            decks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--penetration") == 0 && i + 1 < argc) {
+            penetration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-eval") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "--rng") == 0 && i + 1 < argc) {
+            if (rng_kind_from_name(argv[++i], &kind) < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+    if (hands < 1) hands = 1;
+    if (decks < 1 || decks > SHOE_MAX_DECKS || !(penetration > 0.0 && penetration <= 1.0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (bench) {
+        Rng rng;
+        rng_seed(&rng, kind, seed);
+        return bench_eval(hands, &rng, decks, penetration);
+    }
+
+    Strategy fn = NULL;
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++) {
+        if (strcmp(strategy, strategies[i].name) == 0) fn = strategies[i].fn;
+    }
+    if (!fn) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SimThread *threads = calloc((size_t)nthreads, sizeof(*threads));
+    pthread_t *tids = calloc((size_t)nthreads, sizeof(*tids));
+    if (!threads || !tids) {
+        perror("calloc");
+        return 1;
+    }
+
+    Rng master;
+    rng_seed(&master, kind, seed);
+
+    double t0 = now_sec();
+    for (long i = 0; i < nthreads; i++) {
+        threads[i].hands = hands / nthreads + (i < hands % nthreads ? 1 : 0);
+        threads[i].decks = decks;
+        threads[i].penetration = penetration;
+        rng_split(&master, &threads[i].rng);
+        threads[i].strategy = fn;
+        if (pthread_create(&tids[i], NULL, sim_main, &threads[i]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    long long wins = 0, pushes = 0, losses = 0, blackjacks = 0, busts = 0;
+    unsigned long long shuffles = 0;
+    for (long i = 0; i < nthreads; i++) {
+        pthread_join(tids[i], NULL);
+        wins += threads[i].wins;
+        pushes += threads[i].pushes;
+        losses += threads[i].losses;
+        blackjacks += threads[i].blackjacks;
+        busts += threads[i].busts;
+        shuffles += threads[i].shuffles;
+    }
+    double elapsed = now_sec() - t0;
+
+    // every hand is +1, 0 or -1, so E[x^2] is simply the share of decided hands
+    double n = (double)hands;
+    double ev = (double)(wins - losses) / n;
+    double variance = (double)(wins + losses) / n - ev * ev;
+    double half_ci = 1.96 * sqrt(variance / n);
+
+    printf("strategy      %s\n", strategy);
+    printf("hands         %lld\n", hands);
+    printf("threads       %ld\n", nthreads);
+    printf("seed          %llu (%s)\n", (unsigned long long)seed,
+           kind == RNG_PCG32 ? "pcg32" : "xoshiro256**");
+    printf("shoe          %d deck%s, cut at %.0f%%, %llu shuffles (%.1f hands each)\n",
+           decks, decks == 1 ? "" : "s", penetration * 100.0, shuffles,
+           shuffles ? n / (double)shuffles : 0.0);
+    printf("win/push/lose %.3f%% / %.3f%% / %.3f%%\n",
+           100.0 * (double)wins / n, 100.0 * (double)pushes / n, 100.0 * (double)losses / n);
+    printf("blackjacks    %.3f%%\n", 100.0 * (double)blackjacks / n);
+    printf("busts         %.3f%%\n", 100.0 * (double)busts / n);
+    printf("EV per hand   %+.5f  (95%% CI %+.5f .. %+.5f)\n", ev, ev - half_ci, ev + half_ci);
+    printf("variance      %.5f\n", variance);
+    printf("elapsed       %.3f s (%.2fM hands/sec)\n", elapsed, n / elapsed / 1e6);
+
+    free(threads);
+    free(tids);
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include "../include/stats.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+__thread ServerStats *stats_local = NULL;
+
+static ServerStats *blocks = NULL;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t started_ns;
+
+/* what the previous report saw, for the "last" rates */
+static uint64_t prev_ns;
+static uint64_t prev_rounds, prev_decisions;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void stats_register(ServerStats *s) {
+    pthread_mutex_lock(&lock);
+    if (!blocks) started_ns = prev_ns = now_ns();
+    s->next = blocks;
+    blocks = s;
+    pthread_mutex_unlock(&lock);
+}
+
+/* ---------- recording ---------- */
+
+uint64_t stats_clock(void) {
+    return stats_local ? now_ns() : 0;
+}
+
+/* 0-3 exactly, then four buckets per power of two */
+static int bucket_of(uint64_t ns) {
+    if (ns < 4) return (int)ns;
+    int e = 63 - __builtin_clzll(ns);
+    int b = (e - 1) * 4 + (int)((ns >> (e - 2)) & 3);
+    return b < STAT_BUCKETS ? b : STAT_BUCKETS - 1;
+}
+
+/* upper edge of a bucket, the value a percentile in it is reported as */
+static uint64_t bucket_top(int b) {
+    if (b < 4) return (uint64_t)b;
+    int e = b / 4 + 1;
+    return ((uint64_t)(4 + b % 4 + 1)) << (e - 2);
+}
+
+void stats_phase(StatPhase p, uint64_t start) {
+    ServerStats *s = stats_local;
+    if (!s || !start) return;
+    uint64_t *slot = &s->hist[p][bucket_of(now_ns() - start)];
+    __atomic_store_n(slot, __atomic_load_n(slot, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+/* ---------- reporting ---------- */
+
+typedef struct {
+    uint64_t counters[STAT_COUNTERS];
+    uint64_t hist[PHASE_COUNT][STAT_BUCKETS];
+    int threads;
+} Totals;
+
+static void collect(Totals *t) {
+    memset(t, 0, sizeof(*t));
+    for (ServerStats *s = blocks; s; s = s->next) {
+        for (int c = 0; c < STAT_COUNTERS; c++)
+            t->counters[c] += __atomic_load_n(&s->counters[c], __ATOMIC_RELAXED);
+        for (int p = 0; p < PHASE_COUNT; p++)
+            for (int b = 0; b < STAT_BUCKETS; b++)
+                t->hist[p][b] += __atomic_load_n(&s->hist[p][b], __ATOMIC_RELAXED);
+        t->threads++;
+    }
+}
+
+/* in microseconds, from the bucket holding the q-th fraction of samples */
+static double percentile_us(const uint64_t *hist, uint64_t n, double q) {
+    uint64_t want = (uint64_t)(q * (double)n + 0.5), seen = 0;
+    if (want < 1) want = 1;
+    for (int b = 0; b < STAT_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= want) return (double)bucket_top(b) / 1000.0;
+    }
+    return (double)bucket_top(STAT_BUCKETS - 1) / 1000.0;
+}
+
+static size_t put(char *buf, size_t room, size_t len, const char *fmt, ...) {
+    if (len >= room) return len;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + len, room - len, fmt, ap);
+    va_end(ap);
+    if (n < 0) return len;
+    return len + (size_t)n < room ? len + (size_t)n : room - 1;
+}
+
+static const char *phase_names[PHASE_COUNT] = {
+    "deal", "think", "decision", "dealer", "results", "stall"
+};
+
+size_t stats_format(char *buf, size_t room) {
+    static Totals t;
+    if (room == 0) return 0;
+    buf[0] = '\0';
+
+    pthread_mutex_lock(&lock);
+    collect(&t);
+    uint64_t now = now_ns();
+    double up = (double)(now - started_ns) / 1e9;
+    double since = (double)(now - prev_ns) / 1e9;
+    uint64_t *c = t.counters;
+    uint64_t d_rounds = c[STAT_ROUNDS] - prev_rounds;
+    uint64_t d_decisions = c[STAT_DECISIONS] - prev_decisions;
+    prev_ns = now;
+    prev_rounds = c[STAT_ROUNDS];
+    prev_decisions = c[STAT_DECISIONS];
+    pthread_mutex_unlock(&lock);
+
+    double rounds = c[STAT_ROUNDS] ? (double)c[STAT_ROUNDS] : 1.0;
+    if (up <= 0.0) up = 1e-9;
+    if (since <= 0.0) since = 1e-9;
+
+    size_t n = 0;
+    n = put(buf, room, n, "uptime %.1f s, %d shard%s\n", up, t.threads, t.threads == 1 ? "" : "s");
+    n = put(buf, room, n, "rounds %llu (%.1f/sec, last %.1f s: %.1f/sec)\n",
+            (unsigned long long)c[STAT_ROUNDS], (double)c[STAT_ROUNDS] / up,
+            since, (double)d_rounds / since);
+    n = put(buf, room, n, "decisions %llu (%.1f/sec, last: %.1f/sec), hints %llu, timeouts %llu\n",
+            (unsigned long long)c[STAT_DECISIONS], (double)c[STAT_DECISIONS] / up,
+            (double)d_decisions / since,
+            (unsigned long long)c[STAT_HINTS], (unsigned long long)c[STAT_TIMEOUTS]);
+    n = put(buf, room, n, "connections %llu active, %llu opened, %llu closed, %llu mid-turn\n",
+            (unsigned long long)(c[STAT_CONNECTS] - c[STAT_CLOSES]),
+            (unsigned long long)c[STAT_CONNECTS], (unsigned long long)c[STAT_CLOSES],
+            (unsigned long long)c[STAT_MID_TURN]);
+    n = put(buf, room, n, "bytes %llu out, %llu in (%.1f per round)\n",
+            (unsigned long long)c[STAT_BYTES_OUT], (unsigned long long)c[STAT_BYTES_IN],
+            (double)(c[STAT_BYTES_OUT] + c[STAT_BYTES_IN]) / rounds);
+    n = put(buf, room, n, "syscalls %llu send, %llu recv, %llu wait (%.1f per round); "
+            "%llu io_uring requests (%.1f per round), %llu out of buffers\n",
+            (unsigned long long)c[STAT_SENDS], (unsigned long long)c[STAT_RECVS],
+            (unsigned long long)c[STAT_POLLS],
+            (double)(c[STAT_SENDS] + c[STAT_RECVS] + c[STAT_POLLS]) / rounds,
+            (unsigned long long)c[STAT_RING_SQES], (double)c[STAT_RING_SQES] / rounds,
+            (unsigned long long)c[STAT_RX_NOBUFS]);
+    n = put(buf, room, n, "slow readers %llu bytes queued, %llu stalls, %llu rounds sat out, %llu evicted\n",
+            (unsigned long long)c[STAT_TX_BACKLOG], (unsigned long long)c[STAT_TX_STALLS],
+            (unsigned long long)c[STAT_SAT_OUT], (unsigned long long)c[STAT_EVICTIONS]);
+    n = put(buf, room, n, "journal %llu rounds waited for the writer\n",
+            (unsigned long long)c[STAT_JOURNAL_WAITS]);
+
+    n = put(buf, room, n, "%-9s %10s %10s %10s %10s %10s\n",
+            "phase(us)", "count", "p50", "p99", "p999", "max");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        uint64_t count = 0;
+        int top = 0;
+        for (int b = 0; b < STAT_BUCKETS; b++) {
+            count += t.hist[p][b];
+            if (t.hist[p][b]) top = b;
+        }
+        if (count == 0) {
+            n = put(buf, room, n, "%-9s %10d %10s %10s %10s %10s\n", phase_names[p], 0, "-", "-", "-", "-");
+            continue;
+        }
+        n = put(buf, room, n, "%-9s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+                phase_names[p], (unsigned long long)count,
+                percentile_us(t.hist[p], count, 0.50), percentile_us(t.hist[p], count, 0.99),
+                percentile_us(t.hist[p], count, 0.999), (double)bucket_top(top) / 1000.0);
+    }
+    return n;
+}
+
+/* ---------- endpoint ---------- */
+
+static void *serve_main(void *arg) {
+    int lfd = (int)(intptr_t)arg;
+    static char report[4096];
+    while (1) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("stats accept");
+            break;
+        }
+        size_t len = stats_format(report, sizeof(report)), off = 0;
+        while (off < len) {
+            ssize_t w = send(fd, report + off, len - off, MSG_NOSIGNAL);
+            if (w <= 0) break;
+            off += (size_t)w;
+        }
+        close(fd);
+    }
+    close(lfd);
+    return NULL;
+}
+
+int stats_serve(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "stats socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);   // a stale socket from a previous run
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+        perror("stats socket");
+        close(fd);
+        return -1;
+    }
+
+    pthread_t th;
+    int rc = pthread_create(&th, NULL, serve_main, (void *)(intptr_t)fd);
+    if (rc != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+        close(fd);
+        return -1;
+    }
+    pthread_detach(th);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include "../include/strategy.h"
+
+/* dealer_odds[][] and hint_table[][][], written by gen_tables */
+#include "strategy_tables.h"
+
+/* up cards index the tables as 1 (ace) to 10 (any ten-valued card) */
+static int up_index(Card up) {
+    int r = card_rank(up);
+    return r > 10 ? 10 : r;
+}
+
+Hint strategy_hint(const Hand *player, Card up) {
+    int v = hand_value(player);
+    if (v > 21) return HINT_STAND;
+    return (Hint)hint_table[hand_is_soft(player)][v][up_index(up)];
+}
+
+const double *strategy_dealer_odds(Card up) {
+    return dealer_odds[up_index(up)];
+}
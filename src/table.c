@@ -0,0 +1,495 @@
+#include "../include/table.h"
+#include "../include/lobby.h"
+#include "../include/stats.h"
+#include "../include/strategy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int table_decks = SHOE_DEFAULT_DECKS;
+double table_penetration = SHOE_DEFAULT_PENETRATION;
+ShoePool *table_shoe_pool = NULL;
+int table_turn_timeout_ms = 30000;
+int table_lobby_wait_ms = 0;
+int table_idle_turns = 3;
+Journal *table_journal = NULL;
+
+/* ---------- seating ---------- */
+
+void table_init(Table *t, int id, uint64_t seed) {
+    memset(t, 0, sizeof(*t));
+    t->id = id;
+    t->state = TABLE_IDLE;
+    t->turn = -1;
+    t->seed = seed;
+    hand_init(&t->dealer);
+    shoe_init(&t->shoe, table_decks, table_penetration);
+    shoe_seed(&t->shoe, seed);
+    if (table_shoe_pool) shoe_attach_pool(&t->shoe, table_shoe_pool);
+}
+
+int table_count_active(const Table *t) {
+    return __builtin_popcount(t->seated);
+}
+
+/* Seated and not so far behind on output that they sit this round out */
+static int count_ready(const Table *t) {
+    int c = 0;
+    for (unsigned m = t->seated; m; m &= m - 1)
+        if (!t->seats[__builtin_ctz(m)]->congested) c++;
+    return c;
+}
+
+int table_seat_player(Table *t, PlayerConn *pc) {
+    if (t->seated == ALL_SEATS) return -1;
+    int i = __builtin_ctz(~t->seated);
+    t->seats[i] = pc;
+    t->seated |= 1u << i;
+    lobby_update(t);
+    pc->table = t;
+    pc->seat  = i;
+    pc->state = PLAYER_WAITING;
+    hand_init(&pc->hand);
+    return i;
+}
+
+void table_remove_player(Table *t, PlayerConn *pc) {
+    if (t->timers) timer_cancel(t->timers, &pc->deadline);
+    if (pc->seat >= 0 && pc->seat < MAX_PLAYERS && t->seats[pc->seat] == pc) {
+        // dealt into this round: the hand is forfeit
+        if (pc->state != PLAYER_WAITING) journal_action(&t->journal, pc->seat, JOURNAL_ACT_LEFT);
+        t->seats[pc->seat] = NULL;
+        t->seated &= ~(1u << pc->seat);
+        lobby_update(t);
+    }
+    pc->table = NULL;
+    pc->seat  = -1;
+}
+
+/* ---------- spectators ---------- */
+
+int table_watch(Table *t, PlayerConn *pc) {
+    if (pc->evict) return -1;   // on the way out already
+    if (pc->tx_inflight) return -1;   // an io_uring send still owns the backlog
+    if (pc->shm) return -1;   // the feed is written to sockets only
+    Watch *w = malloc(sizeof(*w));
+    if (!w) return -1;
+    if (!t->feed) {
+        t->feed = malloc(sizeof(*t->feed));
+        if (!t->feed) {
+            free(w);
+            return -1;
+        }
+        feed_init(t->feed);
+    }
+
+    table_remove_player(t, pc);
+    watch_init(w);
+    pc->watch = w;
+    pc->table = t;
+    pc->state = PLAYER_DONE;
+    pc->next_spectator = t->spectators;
+    if (t->spectators) t->spectators->pprev_spectator = &pc->next_spectator;
+    pc->pprev_spectator = &t->spectators;
+    t->spectators = pc;
+
+    // the last thing to go through the connection's own queue
+    conn_send(pc, OP_WATCH);
+    conn_flush(pc);
+
+    // and whatever the socket hasn't taken yet goes out ahead of the feed
+    const char *unsent;
+    size_t len = conn_take_backlog(pc, &unsent);
+    if (len) {
+        Broadcast *b = broadcast_new(unsent, len);
+        if (b) watch_push(w, pc->socket_fd, b);
+        broadcast_release(b);
+    }
+    printf("Table %d: a player is now watching.\n", t->id);
+    return 0;
+}
+
+void table_remove_spectator(Table *t, PlayerConn *pc) {
+    if (!pc->watch) return;
+    *pc->pprev_spectator = pc->next_spectator;
+    if (pc->next_spectator) pc->next_spectator->pprev_spectator = pc->pprev_spectator;
+    pc->next_spectator = NULL;
+    pc->pprev_spectator = NULL;
+    watch_clear(pc->watch);
+    free(pc->watch);
+    pc->watch = NULL;
+    pc->table = NULL;
+
+    if (!t->spectators) {
+        free(t->feed);
+        t->feed = NULL;
+    }
+}
+
+/* Each framing's events so far become one shared broadcast, queued on every
+ * spectator; one that is too far behind, or gone, is dropped here. */
+static void publish_feed(Table *t) {
+    Feed *f = t->feed;
+    if (!f || (f->text_len == 0 && f->binary_len == 0)) return;
+    Broadcast *text = broadcast_new(f->text, f->text_len);
+    Broadcast *binary = broadcast_new(f->binary, f->binary_len);
+    feed_init(f);
+
+    PlayerConn *pc = t->spectators;
+    while (pc) {
+        PlayerConn *next = pc->next_spectator;
+        Broadcast *b = pc->binary ? binary : text;
+        if (b && watch_push(pc->watch, pc->socket_fd, b) < 0) {
+            printf("Spectator dropped from table %d.\n", t->id);
+            table_remove_spectator(t, pc);
+            conn_retire(pc);
+        }
+        pc = next;
+    }
+    broadcast_release(text);
+    broadcast_release(binary);
+}
+
+/* The feed to append a public event to, NULL if nobody is watching. Events
+ * about a seat are introduced by SEAT once per run; seat -1 is the table. */
+static Feed *watchers(Table *t, int seat) {
+    if (!t->spectators) return NULL;
+    if (!feed_has_room(t->feed)) {
+        publish_feed(t);
+        if (!t->spectators) return NULL;
+    }
+    Feed *f = t->feed;
+    if (seat >= 0 && seat != f->seat) {
+        feed_send_int(f, OP_SEAT, seat + 1);
+        f->seat = seat;
+    }
+    return f;
+}
+
+/* ---------- game helpers ---------- */
+
+static void send_initial_hands(Table *t) {
+    Feed *f = watchers(t, -1);
+    if (f) feed_send_card(f, OP_DEALER_UP, t->dealer.cards[0]);
+
+    for (unsigned m = t->seated; m; m &= m - 1) {
+        int i = __builtin_ctz(m);
+        PlayerConn *pc = t->seats[i];
+        if (pc->state != PLAYER_IN_ROUND) continue;
+        conn_send_card(pc, OP_DEALER_UP, t->dealer.cards[0]);
+        conn_send_hand(pc, OP_YOUR_HAND, &pc->hand);
+        if ((f = watchers(t, i))) feed_send_hand(f, OP_HAND, &pc->hand);
+    }
+}
+
+static void deal_round(Table *t) {
+    // the shoe carries over between rounds until the cut card comes out
+    if (shoe_begin_round(&t->shoe)) {
+        if (table_shoe_pool) {
+            ShoePoolStats st;
+            shoe_pool_stats(table_shoe_pool, &st);
+            printf("Table %d: cut card reached, next shoe swapped in "
+                   "(pool: %llu ready, %llu dry).\n",
+                   t->id, st.swaps, st.dry);
+        } else {
+            printf("Table %d: cut card reached, shoe shuffled.\n", t->id);
+        }
+    }
+    hand_init(&t->dealer);
+
+    unsigned dealt = 0;
+    for (unsigned m = t->seated; m; m &= m - 1) {
+        PlayerConn *pc = t->seats[__builtin_ctz(m)];
+        if (pc->congested) {
+            stats_count(STAT_SAT_OUT, 1);   // stays PLAYER_WAITING
+            continue;
+        }
+        hand_init(&pc->hand);
+        pc->state = PLAYER_IN_ROUND;
+        dealt |= 1u << pc->seat;
+    }
+    if (table_journal)
+        journal_round_begin(&t->journal, t->id, t->rounds, t->seed, &t->shoe, dealt);
+    t->rounds++;
+
+    // initial deal: 2 cards each player dealt in, 2 to dealer
+    for (int r = 0; r < 2; r++) {
+        for (unsigned m = dealt; m; m &= m - 1) {
+            Card c = shoe_deal(&t->shoe);
+            hand_add_card(&t->seats[__builtin_ctz(m)]->hand, c);
+            journal_card(&t->journal, c);
+        }
+        Card c = shoe_deal(&t->shoe);
+        hand_add_card(&t->dealer, c);
+        journal_card(&t->journal, c);
+    }
+
+    send_initial_hands(t);
+}
+
+/* One event to the player and, as news about their seat, to spectators */
+static void tell(Table *t, PlayerConn *pc, int op) {
+    conn_send(pc, op);
+    Feed *f = watchers(t, pc->seat);
+    if (f) feed_send(f, op);
+}
+
+static void tell_int(Table *t, PlayerConn *pc, int op, int value) {
+    conn_send_int(pc, op, value);
+    Feed *f = watchers(t, pc->seat);
+    if (f) feed_send_int(f, op, value);
+}
+
+static void tell_card(Table *t, PlayerConn *pc, int op, Card c) {
+    conn_send_card(pc, op, c);
+    Feed *f = watchers(t, pc->seat);
+    if (f) feed_send_card(f, op, c);
+}
+
+static void send_prompt(PlayerConn *pc) {
+    conn_send(pc, OP_YOUR_TURN);
+    conn_send_hand(pc, OP_HAND, &pc->hand);
+    conn_send(pc, OP_PROMPT);
+}
+
+/* Restarts on every prompt that follows a real decision, so a HINT or a
+ * garbled line never buys more time */
+static void arm_deadline(Table *t, PlayerConn *pc) {
+    if (t->timers && table_turn_timeout_ms > 0)
+        timer_arm(t->timers, &pc->deadline, timer_now_ms() + (uint64_t)table_turn_timeout_ms);
+}
+
+static void end_turn(Table *t, PlayerConn *pc) {
+    pc->state = PLAYER_DONE;
+    if (t->timers) timer_cancel(t->timers, &pc->deadline);
+}
+
+static void begin_turn(Table *t, PlayerConn *pc) {
+    if (hand_is_blackjack(&pc->hand)) {
+        tell(t, pc, OP_BLACKJACK);
+        pc->state = PLAYER_DONE;
+        return;
+    }
+    pc->state = PLAYER_DECIDING;
+    Feed *f = watchers(t, pc->seat);
+    if (f) feed_send(f, OP_YOUR_TURN);
+    send_prompt(pc);
+    arm_deadline(t, pc);
+    pc->prompted_ns = stats_clock();
+}
+
+static void decide(Table *t, PlayerConn *pc, const ProtoMsg *m) {
+    if (m->op == OP_HIT) {
+        Card c = shoe_deal(&t->shoe);
+        hand_add_card(&pc->hand, c);
+        journal_action(&t->journal, pc->seat, JOURNAL_ACT_HIT);
+        journal_card(&t->journal, c);
+        tell_card(t, pc, OP_HIT, c);
+
+        if (hand_is_bust(&pc->hand)) {
+            tell_int(t, pc, OP_BUST, hand_value(&pc->hand));
+            end_turn(t, pc);
+            return;
+        }
+        if (hand_value(&pc->hand) == 21) {
+            tell_int(t, pc, OP_STAND, 21);
+            end_turn(t, pc);
+            return;
+        }
+        send_prompt(pc);
+        arm_deadline(t, pc);
+        pc->prompted_ns = stats_clock();
+    } else if (m->op == OP_STAND) {
+        journal_action(&t->journal, pc->seat, JOURNAL_ACT_STAND);
+        tell_int(t, pc, OP_STAND, hand_value(&pc->hand));
+        end_turn(t, pc);
+    } else if (m->op == OP_HINT) {
+        // a table lookup; the player still has to decide
+        conn_send_int(pc, OP_HINT, strategy_hint(&pc->hand, t->dealer.cards[0]));
+        conn_send(pc, OP_PROMPT);
+    } else {
+        conn_send(pc, OP_UNKNOWN_COMMAND);
+        send_prompt(pc);
+    }
+}
+
+static void apply_decision(Table *t, PlayerConn *pc, const ProtoMsg *m) {
+    uint64_t start = stats_clock();
+    if (m->op == OP_HIT || m->op == OP_STAND) {
+        pc->missed_turns = 0;
+        stats_count(STAT_DECISIONS, 1);
+        stats_phase(PHASE_THINK, pc->prompted_ns);
+    } else if (m->op == OP_HINT) {
+        stats_count(STAT_HINTS, 1);
+    }
+    decide(t, pc, m);
+    stats_phase(PHASE_DECISION, start);
+}
+
+/* Consume whatever the acting player has sent. Returns 0 if we must wait
+ * for more input, 1 once the player is no longer deciding. */
+static int read_decision(Table *t, PlayerConn *pc) {
+    ProtoMsg m;
+
+    while (pc->state == PLAYER_DECIDING) {
+        int r = conn_recv_msg(pc, &m);
+        if (r == 0) return 0;
+        if (r < 0) {
+            // disconnected during turn
+            printf("Player disconnected during turn.\n");
+            stats_count(STAT_MID_TURN, 1);
+            table_remove_player(t, pc);
+            conn_retire(pc);
+            return 1;
+        }
+        // giving up the seat mid-turn forfeits the hand, as leaving does
+        if (m.op == OP_WATCH && table_watch(t, pc) == 0) return 1;
+        apply_decision(t, pc, &m);
+    }
+    return 1;
+}
+
+void table_expire_turn(Table *t, PlayerConn *pc) {
+    if (pc->table != t || pc->state != PLAYER_DECIDING) return;
+    pc->missed_turns++;
+    stats_count(STAT_TIMEOUTS, 1);
+    printf("Table %d: player %d ran out of time, standing.\n", t->id, pc->seat + 1);
+    journal_action(&t->journal, pc->seat, JOURNAL_ACT_TIMEOUT);
+    tell_int(t, pc, OP_STAND, hand_value(&pc->hand));
+    end_turn(t, pc);
+}
+
+static void send_results(Table *t) {
+    int dealer_val = hand_value(&t->dealer);
+
+    // spectators get the dealer once, then each seat's result
+    Feed *f = watchers(t, -1);
+    if (f) {
+        feed_send_hand(f, OP_DEALER_HAND, &t->dealer);
+        feed_send_int(f, OP_DEALER_VALUE, dealer_val);
+    }
+
+    for (unsigned m = t->seated; m; m &= m - 1) {
+        int i = __builtin_ctz(m);
+        PlayerConn *pc = t->seats[i];
+        if (pc->state == PLAYER_WAITING) continue;
+        int outcome = hand_outcome(&pc->hand, &t->dealer);
+        int result = outcome > 0 ? RESULT_WIN : outcome < 0 ? RESULT_LOSE : RESULT_PUSH;
+
+        conn_send_hand(pc, OP_DEALER_HAND, &t->dealer);
+        conn_send_int(pc, OP_DEALER_VALUE, dealer_val);
+        tell_int(t, pc, OP_PLAYER_VALUE, hand_value(&pc->hand));
+        tell_int(t, pc, OP_RESULT, result);
+
+        // mark end of this round for the client
+        conn_send(pc, OP_ROUND_END);
+    }
+
+    if ((f = watchers(t, -1))) feed_send(f, OP_ROUND_END);
+}
+
+/* Each seat dealt in, in seat order: its result, or gone if it left */
+static void journal_results(Table *t) {
+    JournalRound *r = &t->journal;
+    uint8_t results[JOURNAL_MAX_SEATS];
+    int n = 0;
+    for (unsigned m = r->rec.seats; m; m &= m - 1) {
+        int i = __builtin_ctz(m);
+        if (r->gone & (1u << i)) {
+            results[n++] = JOURNAL_RES_GONE;
+            continue;
+        }
+        int outcome = hand_outcome(&t->seats[i]->hand, &t->dealer);
+        results[n++] = outcome > 0 ? RESULT_WIN : outcome < 0 ? RESULT_LOSE : RESULT_PUSH;
+    }
+    if (journal_round_end(table_journal, r, results)) stats_count(STAT_JOURNAL_WAITS, 1);
+}
+
+/* ---------- state machine ---------- */
+
+static void flush_seats(Table *t) {
+    for (unsigned m = t->seated; m; m &= m - 1)
+        conn_flush(t->seats[__builtin_ctz(m)]);
+}
+
+static int advance(Table *t) {
+    for (;;) {
+        switch (t->state) {
+        case TABLE_IDLE:
+            if (count_ready(t) == 0) return 0;
+            t->state = TABLE_DEALING;
+            break;
+
+        case TABLE_DEALING: {
+            uint64_t start = stats_clock();
+            deal_round(t);
+            stats_phase(PHASE_DEAL, start);
+            t->turn = -1;
+            t->state = TABLE_AWAITING_DECISION;
+            break;
+        }
+
+        case TABLE_AWAITING_DECISION: {
+            PlayerConn *pc = t->turn >= 0 ? t->seats[t->turn] : NULL;
+            if (pc && pc->state == PLAYER_DECIDING) {
+                if (!read_decision(t, pc)) return 0;
+                break;
+            }
+
+            // hand the turn to the next seat dealt into this round
+            int next = -1;
+            unsigned later = t->seated >> (t->turn + 1) << (t->turn + 1);
+            for (; later; later &= later - 1) {
+                int i = __builtin_ctz(later);
+                if (t->seats[i]->state == PLAYER_IN_ROUND) {
+                    next = i;
+                    break;
+                }
+            }
+            if (next < 0) {
+                t->state = TABLE_DEALER_PLAY;
+                break;
+            }
+            t->turn = next;
+            begin_turn(t, t->seats[next]);
+            break;
+        }
+
+        case TABLE_DEALER_PLAY: {
+            uint64_t start = stats_clock();
+            play_dealer_hand(&t->dealer, &t->shoe);
+            for (int i = 2; i < t->dealer.count; i++) journal_card(&t->journal, t->dealer.cards[i]);
+            stats_phase(PHASE_DEALER, start);
+            t->state = TABLE_RESULTS;
+            break;
+        }
+
+        case TABLE_RESULTS: {
+            // timed through the flush: the fan-out is the sends
+            uint64_t start = stats_clock();
+            send_results(t);
+            flush_seats(t);
+            publish_feed(t);
+            stats_phase(PHASE_RESULTS, start);
+            if (t->journal.open) journal_results(t);
+            stats_count(STAT_ROUNDS, 1);
+            for (unsigned m = t->seated; m; m &= m - 1)
+                t->seats[__builtin_ctz(m)]->state = PLAYER_WAITING;
+            t->turn = -1;
+            t->state = TABLE_IDLE;
+            printf("Table %d: round finished.\n", t->id);
+            return count_ready(t) > 0;
+        }
+        }
+    }
+}
+
+int table_advance(Table *t) {
+    int r = advance(t);
+
+    // phase boundary: everything queued for this table goes out now,
+    // one send per connection
+    flush_seats(t);
+    publish_feed(t);
+    return r;
+}
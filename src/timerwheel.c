@@ -0,0 +1,136 @@
+#include "../include/timerwheel.h"
+#include <string.h>
+#include <time.h>
+
+#define TW_MASK (TW_SLOTS - 1)
+#define TW_SPAN ((uint64_t)1 << (TW_LEVELS * TW_BITS))
+
+uint64_t timer_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+void timer_wheel_init(TimerWheel *w, uint64_t now) {
+    memset(w, 0, sizeof(*w));
+    w->current = now;
+}
+
+void timer_init(Timer *t, TimerFn fn) {
+    t->expires = 0;
+    t->next = NULL;
+    t->pprev = NULL;
+    t->fn = fn;
+}
+
+/* ---------- slots ---------- */
+
+static void link(Timer **head, Timer *t) {
+    t->next = *head;
+    if (t->next) t->next->pprev = &t->next;
+    t->pprev = head;
+    *head = t;
+}
+
+static void unlink(Timer *t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+/* The level is picked by how far off the timer is, the slot by the bits of
+ * its expiry that level covers */
+static void place(TimerWheel *w, Timer *t) {
+    if (t->expires < w->current) t->expires = w->current;
+    uint64_t delta = t->expires - w->current;
+    if (delta >= TW_SPAN) {
+        delta = TW_SPAN - 1;
+        t->expires = w->current + delta;
+    }
+
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= ((uint64_t)1 << ((level + 1) * TW_BITS)))
+        level++;
+    size_t slot = (size_t)(t->expires >> (level * TW_BITS)) & TW_MASK;
+    link(&w->slots[level][slot], t);
+}
+
+void timer_arm(TimerWheel *w, Timer *t, uint64_t expires) {
+    if (timer_armed(t)) unlink(t);
+    else w->count++;
+    t->expires = expires;
+    place(w, t);
+}
+
+void timer_cancel(TimerWheel *w, Timer *t) {
+    if (!timer_armed(t)) return;
+    unlink(t);
+    w->count--;
+}
+
+/* ---------- running ---------- */
+
+/* Re-place every timer in one slot of `level`; they all land lower down */
+static void cascade(TimerWheel *w, int level) {
+    size_t slot = (size_t)(w->current >> (level * TW_BITS)) & TW_MASK;
+    Timer *t = w->slots[level][slot];
+    w->slots[level][slot] = NULL;
+    while (t) {
+        Timer *next = t->next;
+        t->pprev = NULL;
+        place(w, t);
+        t = next;
+    }
+}
+
+int timer_wheel_run(TimerWheel *w, uint64_t now, void *ctx) {
+    int fired = 0;
+    while (w->current <= now) {
+        // nothing armed: skip the idle ticks instead of walking them
+        if (w->count == 0) {
+            w->current = now + 1;
+            break;
+        }
+
+        // level-0 wrap: pull the next slot of level 1 down, and so on up
+        // for as many levels as wrapped together
+        if ((w->current & TW_MASK) == 0) {
+            for (int level = 1; level < TW_LEVELS; level++) {
+                cascade(w, level);
+                if ((w->current >> (level * TW_BITS)) & TW_MASK) break;
+            }
+        }
+
+        // take the slot private first: a callback re-arming 256 ms out lands
+        // in this same slot, and must not fire now. Cancelling one of the
+        // others still works, through its pprev into `due`.
+        Timer **head = &w->slots[0][w->current & TW_MASK];
+        Timer *due = *head;
+        *head = NULL;
+        if (due) due->pprev = &due;
+        w->current++;   // anything armed by a callback lands on a later tick
+        while (due) {
+            Timer *t = due;
+            unlink(t);
+            w->count--;
+            t->fn(t, ctx);
+            fired++;
+        }
+    }
+    return fired;
+}
+
+int timer_wheel_timeout(const TimerWheel *w, uint64_t now) {
+    if (w->count == 0) return -1;
+
+    // the next busy level-0 slot before the next cascade, or that cascade;
+    // a current tick on the boundary cascades before its slot is looked at
+    uint64_t tick = w->current;
+    uint64_t boundary = (tick & TW_MASK) ? (tick | TW_MASK) + 1 : tick;
+    for (; tick < boundary; tick++) {
+        if (w->slots[0][tick & TW_MASK]) break;
+    }
+    uint64_t wait = tick > now ? tick - now : 0;
+    return wait > 60000 ? 60000 : (int)wait;
+}
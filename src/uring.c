@@ -0,0 +1,215 @@
+#include "../include/uring.h"
+#include "../include/stats.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned submit, unsigned wait, unsigned flags,
+                     const void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, arg, argsz);
+}
+
+static int sys_register(int fd, unsigned op, const void *arg, unsigned nargs) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nargs);
+}
+
+/* ---------- setup ---------- */
+
+static int map_rings(Uring *u, const struct io_uring_params *p) {
+    u->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (u->cq_ring_size > u->sq_ring_size) u->sq_ring_size = u->cq_ring_size;
+    u->cq_ring_size = u->sq_ring_size;   // IORING_FEAT_SINGLE_MMAP: one mapping
+
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) return -1;
+    u->cq_ring = u->sq_ring;
+
+    u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        munmap(u->sq_ring, u->sq_ring_size);
+        u->sq_ring = NULL;
+        u->sqes = NULL;
+        return -1;
+    }
+
+    char *sq = u->sq_ring, *cq = u->cq_ring;
+    u->sq_head = (unsigned *)(sq + p->sq_off.head);
+    u->sq_tail = (unsigned *)(sq + p->sq_off.tail);
+    u->sq_array = (unsigned *)(sq + p->sq_off.array);
+    u->sq_mask = *(unsigned *)(sq + p->sq_off.ring_mask);
+    u->sq_entries = p->sq_entries;
+    u->sq_local = *u->sq_tail;
+    u->cq_head = (unsigned *)(cq + p->cq_off.head);
+    u->cq_tail = (unsigned *)(cq + p->cq_off.tail);
+    u->cq_mask = *(unsigned *)(cq + p->cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+    return 0;
+}
+
+static int provide_buffers(Uring *u, unsigned nbufs, unsigned buf_size) {
+    u->br_size = nbufs * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, u->br_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->br == MAP_FAILED) {
+        u->br = NULL;
+        return -1;
+    }
+    u->buf_base = mmap(NULL, (size_t)nbufs * buf_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->buf_base == MAP_FAILED) {
+        u->buf_base = NULL;
+        return -1;
+    }
+    u->buf_count = nbufs;
+    u->buf_size = buf_size;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+    reg.ring_entries = nbufs;
+    reg.bgid = URING_BGID;
+    if (sys_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return -1;
+
+    u->buf_tail = 0;
+    for (unsigned id = 0; id < nbufs; id++) uring_buf_return(u, id);
+    return 0;
+}
+
+/* Multishot recv came in 6.0, after the buffer ring (5.19), and has no
+ * feature bit: post one on a socketpair holding a byte. An older kernel
+ * fails it -EINVAL; a newer one answers with IORING_CQE_F_MORE set. */
+static int check_recv_multishot(Uring *u) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) return -1;
+    int ok = 0;
+    struct io_uring_sqe *sqe;
+    if (write(sv[1], "", 1) == 1 && (sqe = uring_sqe(u))) {
+        uring_prep_recv_multishot(sqe, sv[0], 0);
+        // then its end: the peer hangs up and the receive completes with 0
+        shutdown(sv[1], SHUT_WR);
+        while (uring_wait(u, 1000) == 0) {
+            struct io_uring_cqe *cqe = uring_peek(u);
+            if (!cqe) break;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            uring_seen(u);
+            if (flags & IORING_CQE_F_BUFFER) uring_buf_return(u, flags >> IORING_CQE_BUFFER_SHIFT);
+            if (res > 0 && (flags & IORING_CQE_F_MORE)) ok = 1;
+            if (!(flags & IORING_CQE_F_MORE)) break;
+        }
+    }
+    close(sv[0]);
+    close(sv[1]);
+    if (!ok) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    return 0;
+}
+
+int uring_init(Uring *u, unsigned entries, unsigned nbufs, unsigned buf_size) {
+    memset(u, 0, sizeof(*u));
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    // completions are only reaped from uring_wait(), so the kernel need not
+    // interrupt us to post them
+    p.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    u->fd = sys_setup(entries, &p);
+    if (u->fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        u->fd = sys_setup(entries, &p);
+    }
+    if (u->fd < 0) return -1;
+
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        close(u->fd);
+        errno = ENOTSUP;
+        return -1;
+    }
+    if (map_rings(u, &p) < 0 ||
+        (nbufs && (provide_buffers(u, nbufs, buf_size) < 0 || check_recv_multishot(u) < 0))) {
+        int e = errno;
+        uring_close(u);
+        errno = e;
+        return -1;
+    }
+    return 0;
+}
+
+void uring_close(Uring *u) {
+    if (u->buf_base) munmap(u->buf_base, (size_t)u->buf_count * u->buf_size);
+    if (u->br) munmap(u->br, u->br_size);
+    if (u->sqes && u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+    if (u->sq_ring && u->sq_ring != MAP_FAILED) munmap(u->sq_ring, u->sq_ring_size);
+    if (u->fd >= 0) close(u->fd);
+    memset(u, 0, sizeof(*u));
+    u->fd = -1;
+}
+
+/* ---------- submitting and reaping ---------- */
+
+static unsigned publish(Uring *u) {
+    unsigned n = u->sq_local - *u->sq_tail;
+    __atomic_store_n(u->sq_tail, u->sq_local, __ATOMIC_RELEASE);
+    return n;
+}
+
+struct io_uring_sqe *uring_sqe(Uring *u) {
+    unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    if (u->sq_local - head == u->sq_entries) {
+        unsigned n = publish(u);
+        stats_count(STAT_RING_SQES, n);
+        if (sys_enter(u->fd, n, 0, 0, NULL, 0) < 0 && errno != EINTR && errno != EBUSY)
+            return NULL;
+        head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+        if (u->sq_local - head == u->sq_entries) return NULL;
+    }
+    unsigned idx = u->sq_local & u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    u->sq_local++;
+    return sqe;
+}
+
+int uring_wait(Uring *u, int timeout_ms) {
+    unsigned n = publish(u);
+    stats_count(STAT_RING_SQES, n);
+
+    // completions already waiting: just submit and collect
+    unsigned wait = uring_peek(u) || timeout_ms == 0 ? 0 : 1;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (wait && timeout_ms > 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+    if (sys_enter(u->fd, n, wait, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                  &arg, sizeof(arg)) < 0) {
+        if (errno == ETIME || errno == EINTR || errno == EBUSY || errno == EAGAIN) return 0;
+        return -1;
+    }
+    return 0;
+}
+
+void uring_buf_return(Uring *u, unsigned id) {
+    struct io_uring_buf *b = &u->br->bufs[u->buf_tail & (u->buf_count - 1)];
+    b->addr = (uint64_t)(uintptr_t)uring_buf(u, id);
+    b->len = u->buf_size;
+    b->bid = (uint16_t)id;
+    u->buf_tail++;
+    __atomic_store_n(&u->br->tail, u->buf_tail, __ATOMIC_RELEASE);
+}